@@ -48,10 +48,7 @@ classdef mightex < handle
         disp("Connected to camera "+obj.Serial);
         calllib('libmightex', 'mightex_set_mode', obj.Mtx, 0); 
         obj.NPixels = calllib('libmightex', 'mightex_pixel_count', obj.Mtx);
-        obj.Frame = calllib('libmightex', 'mightex_frame_p', obj.Mtx);
-        obj.Frame.setdatatype('uint16Ptr', obj.NPixels, 1);
-        obj.RawFrame = calllib('libmightex', 'mightex_raw_frame_p', obj.Mtx);
-        obj.RawFrame.setdatatype('uint16Ptr', obj.NPixels, 1);
+        obj.framePointers();
       end
     end
     
@@ -101,10 +98,31 @@ classdef mightex < handle
       calllib('libmightex', 'mightex_read_frame', obj.Mtx);
       bias = calllib('libmightex', 'mightex_dark_mean', obj.Mtx);
       calllib('libmightex', 'mightex_apply_filter', obj.Mtx, libpointer);
+      obj.framePointers();
       frame = obj.Frame.value;
       rawFrame = obj.RawFrame.value;
     end
     
+    function [frames, meta] = readFrames(obj, n, filtered)
+      %readFrames read n frames with a single library call
+      %   Return the raw frames (or the filtered ones, if filtered is true)
+      %   as a NPixels x n matrix, and their metadata as a 6 x n matrix with
+      %   rows: timestamp, exposure time (0.1 ms), triggered, trigger count,
+      %   dark mean, missed triggers. Fewer columns on timeout.
+      if (nargin < 3)
+        filtered = false;
+      end
+      framesPtr = libpointer('uint16Ptr', zeros(obj.NPixels, n, 'uint16'));
+      metaPtr = libpointer('uint16Ptr', zeros(6, n, 'uint16'));
+      got = calllib('libmightex', 'mightex_acquire_into', obj.Mtx, ...
+        framesPtr, metaPtr, n, uint32(filtered));
+      frames = reshape(framesPtr.Value, obj.NPixels, n);
+      frames = frames(:, 1:got);
+      meta = reshape(metaPtr.Value, 6, n);
+      meta = meta(:, 1:got);
+      obj.framePointers();
+    end
+    
     function plotFrame(m, thr)
       %plotFrame Plot the last frame readed
       frame = m.Frame.value;
@@ -124,6 +142,16 @@ classdef mightex < handle
     end
   end
   
+  methods (Access = private)
+    function framePointers(obj)
+      %framePointers Point to the current frame, which moves at each read
+      obj.Frame = calllib('libmightex', 'mightex_frame_p', obj.Mtx);
+      obj.Frame.setdatatype('uint16Ptr', obj.NPixels, 1);
+      obj.RawFrame = calllib('libmightex', 'mightex_raw_frame_p', obj.Mtx);
+      obj.RawFrame.setdatatype('uint16Ptr', obj.NPixels, 1);
+    end
+  end
+  
   methods (Static)
     function ver = swVersion()
       %swVersion The version of the mightex library
@@ -0,0 +1,859 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _WIN32
+#include <stdint.h>
+#include <getopt.h>
+#else
+#include <unistd.h>
+#include <libgen.h>
+#include <time.h>
+#endif // _WIN32
+#include <mightex1304.h>
+
+static double now(void) {
+#ifdef _WIN32
+  LARGE_INTEGER f, t;
+  QueryPerformanceFrequency(&f);
+  QueryPerformanceCounter(&t);
+  return (double)t.QuadPart / (double)f.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1.0E9;
+#endif
+}
+
+static void report(const char *name, int n, double dt) {
+  printf("%-10s %6d frames in %8.3f s: %9.1f frames/s\n", name, n, dt, n / dt);
+}
+
+// in trigger mode, also report the triggers missed by the last test
+static void report_triggers(mightex_t *m, unsigned long *dropped) {
+  unsigned long n = mightex_dropped_triggers(m);
+  printf("%-10s %6lu missed triggers\n", "", n - *dropped);
+  *dropped = n;
+}
+
+// synchronous path, as in grab.c: poll the buffer count, then read
+static int bench_sync(mightex_t *m, int n) {
+  int i;
+  for (i = 0; i < n; i++) {
+    while (mightex_get_buffer_count(m) <= 0)
+      ;
+    if (mightex_read_frame(m) != MTX_OK)
+      return i;
+  }
+  return n;
+}
+
+// burst path: drain all the buffered frames with a single request
+static int bench_burst(mightex_t *m, int n) {
+  int i = 0, rc;
+  while (i < n) {
+    rc = mightex_read_frames(m, 0);
+    if (rc < 0)
+      return i;
+    i += rc;
+  }
+  return i;
+}
+
+// bulk path, as used through FFI: all the frames and their metadata in a
+// single call, the last ones being those of the last read
+static int bench_acquire(mightex_t *m, int n) {
+  int done, last;
+  uint16_t *dst = malloc((size_t)n * MTX_PIXELS * sizeof(uint16_t));
+  uint16_t *meta = malloc((size_t)n * MTX_META_VALUES * sizeof(uint16_t));
+  done = dst && meta ? mightex_acquire_into(m, dst, meta, n, MTX_ACQUIRE_RAW)
+                     : 0;
+  last = mightex_frame_count(m) - 1;
+  if (done > 0 &&
+      (memcmp(dst + (size_t)(done - 1) * MTX_PIXELS,
+              mightex_raw_frame_at(m, last), MTX_PIXELS * sizeof(uint16_t)) ||
+       meta[(done - 1) * MTX_META_VALUES + MTX_META_TIMESTAMP] !=
+           mightex_frame_timestamp_at(m, last))) {
+    fprintf(stderr, "Acquired frames differ from the last read\n");
+    done = 0;
+  }
+  free(dst);
+  free(meta);
+  return done;
+}
+
+static int bench_stream(mightex_t *m, int n, int depth, int unplug) {
+  int i = 0, rc;
+  if (mightex_stream_start(m, depth, NULL, NULL) != MTX_OK)
+    return 0;
+  while (i < n) {
+    rc = mightex_stream_poll(m, 1000);
+    if (rc < 0)
+      break;
+    // halfway through, pull the (simulated) cable
+    if (unplug && i < n / 2 && i + rc >= n / 2)
+      mightex_simulate_unplug(m, unplug);
+    i += rc;
+  }
+  mightex_stream_stop(m);
+  return i;
+}
+
+// acquisition thread: pop frames from the queue
+static int bench_thread(mightex_t *m, int n, int unplug) {
+  int i;
+  if (mightex_acquisition_start(m, 64) != MTX_OK)
+    return 0;
+  for (i = 0; i < n; i++) {
+    if (mightex_pop_frame(m, 1000) != MTX_OK)
+      break;
+    if (unplug && i == n / 2)
+      mightex_simulate_unplug(m, unplug);
+    // commands from this thread while the acquisition thread reconnects
+    if (unplug && i >= n / 2 && i % 8 == 0)
+      mightex_gpio_read(m, 0);
+  }
+  if (mightex_dropped_frames(m) > 0)
+    fprintf(stderr, "Dropped frames: %lu\n", mightex_dropped_frames(m));
+  mightex_acquisition_stop(m);
+  return i;
+}
+
+#ifndef _WIN32
+// triggered frames popped slower than they come: those the queue drops are
+// dropped frames, not missed triggers; the camera itself still misses a few
+// when the acquisition thread gets little time, hence the loose bound
+static int bench_slow_consumer(mightex_t *m, int n) {
+  int i;
+  unsigned long frames, missed = mightex_dropped_triggers(m);
+  if (mightex_acquisition_start(m, 4) != MTX_OK)
+    return 0;
+  for (i = 0; i < n; i++) {
+    if (mightex_pop_frame(m, 1000) != MTX_OK)
+      break;
+    usleep(2000);
+  }
+  frames = mightex_dropped_frames(m);
+  mightex_acquisition_stop(m);
+  missed = mightex_dropped_triggers(m) - missed;
+  printf("%-10s %6lu frames dropped, %lu missed triggers\n", "", frames,
+         missed);
+  return i == n && frames > 0 && missed < frames / 2;
+}
+#endif
+
+// Pixel kernels
+//
+// Reference implementations, as in the plain loops the library used to have,
+// timed against the library ones on the same frame. Results must match.
+
+static void filter_dark_ref(mightex_t *m, uint16_t *const data, uint16_t len,
+                            void *ud) {
+  uint16_t i, dark = mightex_dark_mean(m);
+  for (i = 0; i < len; i++)
+    data[i] = data[i] < dark ? 0 : data[i] - dark;
+}
+
+static double estimator_center_ref(mightex_t *m, uint16_t *const data,
+                                   uint16_t len, void *ud) {
+  uint16_t i;
+  double num = 0, den = 0;
+  uint16_t thr = mightex_dark_mean(m) * 3;
+  for (i = 0; i < len; i++) {
+    if (data[i] < thr)
+      continue;
+    num += (i * data[i]);
+    den += data[i];
+  }
+  return num / den;
+}
+
+// time per frame (ns) of copying the raw frame and filtering it; a NULL
+// filter means the library default
+static double time_filter(mightex_t *m, mightex_filter_t *filter, int n) {
+  int i;
+  double t0;
+  uint16_t *raw = mightex_raw_frame_p(m), *data = mightex_frame_p(m);
+  if (filter)
+    mightex_set_filter(m, filter);
+  else
+    mightex_reset_filter(m);
+  t0 = now();
+  for (i = 0; i < n; i++) {
+    memcpy(data, raw, mightex_pixel_count(m) * sizeof(uint16_t));
+    mightex_apply_filter(m, NULL);
+  }
+  return (now() - t0) / n * 1.0E9;
+}
+
+// time per frame (ns) of the estimator, a NULL one meaning the library default
+static double time_estimator(mightex_t *m, mightex_estimator_t *estimator,
+                             int n, double *result, void *ud) {
+  int i;
+  double t0;
+  if (estimator)
+    mightex_set_estimator(m, estimator);
+  else
+    mightex_reset_estimator(m);
+  t0 = now();
+  for (i = 0; i < n; i++)
+    *result = mightex_apply_estimator(m, ud);
+  return (now() - t0) / n * 1.0E9;
+}
+
+static double time_process(mightex_t *m, int n, double *result) {
+  int i;
+  double t0;
+  mightex_reset_filter(m);
+  mightex_reset_estimator(m);
+  t0 = now();
+  for (i = 0; i < n; i++)
+    *result = mightex_process(m, NULL);
+  return (now() - t0) / n * 1.0E9;
+}
+
+// ref is the time of the plain loops, or of the separate calls for process;
+// isa is the instruction set of the library kernel
+static void report_kernel(const char *name, const char *isa, double ref,
+                          double lib) {
+  printf("%-18s %9.1f ns/frame (%s), %9.1f ns/frame (before): %5.2fx\n",
+         name, lib, isa, ref, ref / lib);
+}
+
+static int bench_kernels(mightex_t *m, int n) {
+  int ok = 1;
+  size_t size = mightex_pixel_count(m) * sizeof(uint16_t);
+  uint16_t *ref = malloc(size);
+  double t_ref, t_lib, x_ref = 0, x_lib = 0, t_sep;
+
+  while (mightex_wait_frame(m, 1000) == 0)
+    ;
+  if (!ref || mightex_read_frame(m) != MTX_OK) {
+    free(ref);
+    return 0;
+  }
+
+  t_ref = time_filter(m, filter_dark_ref, n);
+  memcpy(ref, mightex_frame_p(m), size);
+  t_lib = t_sep = time_filter(m, NULL, n);
+  report_kernel("dark subtraction", mightex_simd(), t_ref, t_lib);
+  if (memcmp(ref, mightex_frame_p(m), size) != 0) {
+    fprintf(stderr, "Dark subtraction results differ\n");
+    ok = 0;
+  }
+
+  // on the filtered frame, as in grab.c
+  t_ref = time_estimator(m, estimator_center_ref, n, &x_ref, NULL);
+  t_lib = time_estimator(m, NULL, n, &x_lib, NULL);
+  report_kernel("centroid", mightex_simd(), t_ref, t_lib);
+  if (memcmp(&x_ref, &x_lib, sizeof(double)) != 0) {
+    fprintf(stderr, "Centroids differ: %.17g vs. %.17g\n", x_ref, x_lib);
+    ok = 0;
+  }
+  t_sep += t_lib;
+
+  // the same, with mightex_process() against the separate library calls
+  t_lib = time_process(m, n, &x_lib);
+  report_kernel("process (fused)", mightex_simd(), t_sep, t_lib);
+  if (memcmp(ref, mightex_frame_p(m), size) != 0 ||
+      memcmp(&x_ref, &x_lib, sizeof(double)) != 0) {
+    fprintf(stderr, "Fused processing results differ\n");
+    ok = 0;
+  }
+
+  free(ref);
+  return ok;
+}
+
+// mightex_process() on a tracking window against the full frame; the window
+// starts off the spot, so that it has to be found by a full-frame search
+// 1 if the pixels of the view outside [lo, hi) are those of the raw frame
+static int raw_around(mightex_t *m, int lo, int hi) {
+  const uint16_t *raw = mightex_raw_frame_p(m), *data = mightex_frame_p(m);
+  size_t tail = (MTX_PIXELS - hi) * sizeof(uint16_t);
+  return memcmp(data, raw, lo * sizeof(uint16_t)) == 0 &&
+         memcmp(data + hi, raw + hi, tail) == 0;
+}
+
+static int bench_roi(mightex_t *m, int n, int simulated) {
+  int ok = 1;
+  double t_full, t_roi, x_full = 0, x_roi = 0;
+  mightex_roi_t roi = {0, 256};
+  mightex_roi_t overlap[2] = {{1700, 120}, {1800, 300}};
+
+  if (simulated) {
+    mightex_simulate_scene(m, MTX_SCENE_SPOT);
+    mightex_set_exptime(m, 10);
+    while (mightex_wait_frame(m, 1000) == 0)
+      ;
+    if (mightex_read_frame(m) != MTX_OK)
+      return 0;
+  }
+  mightex_set_roi(m, NULL, 0);
+  t_full = time_process(m, n, &x_full);
+  mightex_set_roi(m, &roi, 1);
+  mightex_set_roi_tracking(m, 1);
+  t_roi = time_process(m, n, &x_roi);
+  mightex_roi(m, &roi, 1);
+  report_kernel("process (roi)", mightex_simd(), t_full, t_roi);
+  printf("  window [%u, %u), %lu searches\n", roi.start,
+         roi.start + roi.width, mightex_roi_searches(m));
+  mightex_set_roi(m, NULL, 0);
+
+  // the window holds all the spot, so the centroid is the same
+  if (simulated && (memcmp(&x_full, &x_roi, sizeof(double)) != 0 ||
+                    mightex_roi_searches(m) != 1)) {
+    fprintf(stderr, "Tracking results differ: %.17g vs. %.17g\n", x_full,
+            x_roi);
+    ok = 0;
+  }
+
+  // overlapping windows are filtered as one span, while the centroid is 
+  // still that of window 0, which cuts the spot; on a new frame, not 
+  // filtered yet
+  while (mightex_wait_frame(m, 1000) == 0)
+    ;
+  if (mightex_read_frame(m) != MTX_OK)
+    return 0;
+  mightex_set_roi(m, overlap, 2);
+  mightex_reset_filter(m);
+  mightex_reset_estimator(m);
+  mightex_apply_filter(m, NULL);
+  x_full = mightex_apply_estimator(m, NULL);
+  x_roi = mightex_process(m, NULL);
+  if (!raw_around(m, 1700, 2100)) {
+    fprintf(stderr, "Pixels outside the windows are not the raw ones\n");
+    ok = 0;
+  }
+  mightex_set_roi(m, NULL, 0);
+  if (memcmp(&x_full, &x_roi, sizeof(double)) != 0) {
+    fprintf(stderr, "Overlapping windows results differ: %.17g vs. %.17g\n",
+            x_full, x_roi);
+    ok = 0;
+  }
+
+  // same around a single window, filtered along with the centroid
+  while (mightex_wait_frame(m, 1000) == 0)
+    ;
+  if (mightex_read_frame(m) != MTX_OK)
+    return 0;
+  mightex_set_roi(m, overlap, 1);
+  mightex_process(m, NULL);
+  if (!raw_around(m, 1700, 1820)) {
+    fprintf(stderr, "Pixels around the window are not the raw ones\n");
+    ok = 0;
+  }
+  mightex_set_roi(m, NULL, 0);
+  return ok;
+}
+
+// Co-adding as done in application code: plain loops over the raw frame
+static void accumulate_ref(uint32_t *sum, uint64_t *sq, const uint16_t *x) {
+  int i;
+  for (i = 0; i < MTX_PIXELS; i++) {
+    sum[i] += x[i];
+    sq[i] += (uint64_t)x[i] * x[i];
+  }
+}
+
+// check an accumulator against plain sums of frames first to last - 1
+static int check_accumulator(mightex_accumulator_t *acc, uint16_t *frames,
+                             int first, int last) {
+  int i, j, n = last - first;
+  double mean, var, d;
+  double *a_mean = malloc(MTX_PIXELS * sizeof(double));
+  double *a_var = malloc(MTX_PIXELS * sizeof(double));
+  const uint32_t *a_sum = mightex_accumulator_sum(acc);
+  int ok = a_mean && a_var && mightex_accumulator_count(acc) == n;
+
+  if (ok) {
+    mightex_accumulator_mean(acc, a_mean);
+    mightex_accumulator_variance(acc, a_var);
+  }
+  for (i = 0; i < MTX_PIXELS && ok; i++) {
+    uint32_t sum = 0;
+    for (j = first; j < last; j++)
+      sum += frames[j * MTX_PIXELS + i];
+    mean = (double)sum / n;
+    var = 0;
+    for (j = first; j < last; j++) {
+      d = frames[j * MTX_PIXELS + i] - mean;
+      var += d * d / (n - 1);
+    }
+    ok = a_sum[i] == sum && a_mean[i] == mean &&
+         fabs(a_var[i] - var) <= 1.0E-9 * var + 1.0E-9;
+  }
+  free(a_mean);
+  free(a_var);
+  return ok;
+}
+
+// time per frame (ns) of co-adding, in block and sliding mode, and check the
+// results on frames of random values over the full 16-bit range
+static int bench_accumulate(mightex_t *m, int n) {
+  int i, ok = 1;
+  uint32_t seed = 2463534242u;
+  uint16_t *frames = malloc(13 * MTX_PIXELS * sizeof(uint16_t));
+  uint32_t *sum = calloc(MTX_PIXELS, sizeof(uint32_t));
+  uint64_t *sq = calloc(MTX_PIXELS, sizeof(uint64_t));
+  uint16_t *raw = mightex_raw_frame_p(m);
+  mightex_accumulator_t *block = mightex_accumulator_new(5, MTX_ACC_BLOCK);
+  mightex_accumulator_t *sliding = mightex_accumulator_new(5, MTX_ACC_SLIDING);
+  double t0, t_ref, t_lib;
+
+  if (!frames || !sum || !sq || !block || !sliding) {
+    ok = 0;
+    goto done;
+  }
+  for (i = 0; i < 13 * MTX_PIXELS; i++) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    frames[i] = (uint16_t)seed;
+  }
+  for (i = 0; i < 13; i++) {
+    mightex_accumulator_add(block, frames + i * MTX_PIXELS);
+    mightex_accumulator_add(sliding, frames + i * MTX_PIXELS);
+  }
+  // blocks restart at frame 10, the window holds the last 5
+  if (!check_accumulator(block, frames, 10, 13) ||
+      !check_accumulator(sliding, frames, 8, 13)) {
+    fprintf(stderr, "Accumulated frames differ\n");
+    ok = 0;
+  }
+
+  t0 = now();
+  for (i = 0; i < n; i++)
+    accumulate_ref(sum, sq, raw);
+  t_ref = (now() - t0) / n * 1.0E9;
+  t0 = now();
+  for (i = 0; i < n; i++)
+    mightex_accumulator_add(block, raw);
+  t_lib = (now() - t0) / n * 1.0E9;
+  report_kernel("accumulate", "scalar", t_ref, t_lib);
+  t0 = now();
+  for (i = 0; i < n; i++)
+    mightex_accumulator_add(sliding, raw);
+  t_lib = (now() - t0) / n * 1.0E9;
+  report_kernel("accumulate (5)", "scalar", t_ref, t_lib);
+
+done:
+  mightex_accumulator_free(block);
+  mightex_accumulator_free(sliding);
+  free(frames);
+  free(sum);
+  free(sq);
+  return ok;
+}
+
+// Statistics as grab.c used to compute them, in two passes, fixed
+static double stats_ref(mightex_t *m, uint16_t *const data, uint16_t len,
+                        void *ud) {
+  int i;
+  uint32_t sum = 0;
+  mightex_stats_t *s = (mightex_stats_t *)ud;
+  for (i = 0; i < len; i++)
+    sum += data[i];
+  s->mean = (double)sum / len;
+  s->min = s->max = data[0];
+  s->std = 0;
+  s->saturated = 0;
+  for (i = 0; i < len; i++) {
+    s->min = s->min < data[i] ? s->min : data[i];
+    s->max = s->max > data[i] ? s->max : data[i];
+    s->std += pow(data[i] - s->mean, 2);
+    s->saturated += data[i] >= MTX_SATURATION;
+  }
+  s->std = sqrt(s->std / (len - 1));
+  return s->std;
+}
+
+static int same_stats(const mightex_stats_t *a, const mightex_stats_t *b) {
+  return a->min == b->min && a->max == b->max && a->mean == b->mean &&
+         a->saturated == b->saturated &&
+         fabs(a->std - b->std) <= 1.0E-9 * a->std;
+}
+
+// time per frame (ns) of the statistics estimator, and check it on the frame
+// and on random values over the full 16-bit range
+static int bench_stats(mightex_t *m, int n) {
+  int i, ok = 1;
+  uint32_t seed = 88172645u, count = 0;
+  uint16_t *noise = malloc(MTX_PIXELS * sizeof(uint16_t));
+  uint32_t histogram[256];
+  mightex_stats_t ref = {0}, lib = {0};
+  double x_ref = 0, x_lib = 0, t_ref, t_lib;
+
+  if (!noise)
+    return 0;
+  for (i = 0; i < MTX_PIXELS; i++) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    noise[i] = (uint16_t)seed;
+  }
+  stats_ref(m, noise, MTX_PIXELS, &ref);
+  lib.histogram = histogram;
+  mightex_estimator_stats(m, noise, MTX_PIXELS, &lib);
+  for (i = 0; i < 256; i++)
+    count += histogram[i];
+  if (!same_stats(&ref, &lib) || ref.saturated == 0 || count != MTX_PIXELS) {
+    fprintf(stderr, "Statistics of random values differ\n");
+    ok = 0;
+  }
+  free(noise);
+
+  t_ref = time_estimator(m, stats_ref, n, &x_ref, &ref);
+  lib.histogram = NULL;
+  t_lib = time_estimator(m, mightex_estimator_stats, n, &x_lib, &lib);
+  report_kernel("stats", mightex_simd(), t_ref, t_lib);
+  if (!same_stats(&ref, &lib)) {
+    fprintf(stderr, "Statistics differ: std %.17g vs. %.17g\n", x_ref, x_lib);
+    ok = 0;
+  }
+  lib.histogram = histogram;
+  t_lib = time_estimator(m, mightex_estimator_stats, n, &x_lib, &lib);
+  report_kernel("stats (histogram)", mightex_simd(), t_ref, t_lib);
+  mightex_reset_estimator(m);
+  return ok;
+}
+
+// time per frame (ns) of the default multi-peak estimator on the current
+// frame; on the simulated camera, also check the peaks of its line scene
+static int bench_peaks(mightex_t *m, int n, int simulated) {
+  int i, found = 0, ok = 1;
+  double t0, dt;
+  mightex_peak_t peaks[8], in_roi[8];
+  mightex_roi_t roi[3];
+
+  if (simulated) {
+    mightex_simulate_scene(m, MTX_SCENE_LINES);
+    mightex_set_exptime(m, 10);
+    while (mightex_wait_frame(m, 1000) == 0)
+      ;
+    if (mightex_read_frame(m) != MTX_OK)
+      return 0;
+    mightex_apply_filter(m, NULL);
+  }
+  t0 = now();
+  for (i = 0; i < n; i++)
+    found = mightex_find_peaks(m, NULL, peaks, 8);
+  dt = (now() - t0) / n * 1.0E9;
+  printf("%-18s %9.1f ns/frame, %d peaks\n", "peaks", dt, found);
+  for (i = 0; i < found; i++)
+    printf("  %7.2f px, amplitude %5.0f, width %4.0f, energy %8.0f\n",
+           peaks[i].centroid, peaks[i].amplitude, peaks[i].width,
+           peaks[i].energy);
+
+  // the lines are at a quarter, a half and three quarters of the sensor
+  if (simulated) {
+    ok = found == 3;
+    for (i = 0; i < found && ok; i++)
+      ok = fabs(peaks[i].centroid - (i + 1) * mightex_pixel_count(m) / 4.0) <= 1;
+    if (!ok)
+      fprintf(stderr, "Peaks of the line scene not found\n");
+    // the same, with a window on each line
+    for (i = 0; i < 3; i++) {
+      roi[i].start = (i + 1) * mightex_pixel_count(m) / 4 - 32;
+      roi[i].width = 64;
+    }
+    mightex_set_roi(m, roi, 3);
+    if (ok && (mightex_find_peaks(m, NULL, in_roi, 8) != found ||
+               memcmp(peaks, in_roi, found * sizeof(mightex_peak_t)) != 0)) {
+      fprintf(stderr, "Peaks in the windows differ\n");
+      ok = 0;
+    }
+    mightex_set_roi(m, NULL, 0);
+  }
+  return ok;
+}
+
+// with auto-exposure, check that the last frame is close to the target
+static int check_exposure(mightex_t *m, const mightex_auto_exposure_t *ae) {
+  int i;
+  uint16_t peak = 0, *raw = mightex_raw_frame_p(m);
+  double level;
+  for (i = 0; i < mightex_pixel_count(m); i++)
+    peak = raw[i] > peak ? raw[i] : peak;
+  level = peak - mightex_dark_mean(m);
+  printf("Exposure time: %.1f ms, peak level %.0f (target %u)\n",
+         mightex_exptime(m), level, ae->target);
+  return level > ae->target * (1 - 2 * ae->tolerance) &&
+         level < ae->target * (1 + 2 * ae->tolerance);
+}
+
+// hold frames across reads and check that neither them nor their filtered
+// views are overwritten by the following reads; also time a hold and release
+#define HELD_FRAMES 8
+static int bench_frames(mightex_t *m, int n) {
+  int i, held = 0, ok = 1;
+  size_t size = MTX_PIXELS * sizeof(uint16_t);
+  uint16_t *copy = malloc(2 * HELD_FRAMES * size);
+  mightex_frame_t *f[HELD_FRAMES];
+  double t0, dt;
+
+  if (!copy)
+    return 0;
+  for (held = 0; held < HELD_FRAMES; held++) {
+    while (mightex_wait_frame(m, 1000) == 0)
+      ;
+    if (mightex_read_frame(m) != MTX_OK)
+      break;
+    mightex_process(m, NULL);
+    f[held] = mightex_frame_hold(m, 0);
+    memcpy(copy + 2 * held * MTX_PIXELS, mightex_raw_frame_p(m), size);
+    memcpy(copy + (2 * held + 1) * MTX_PIXELS, mightex_frame_p(m), size);
+  }
+  for (i = 0; i < held; i++) {
+    if (memcmp(copy + 2 * i * MTX_PIXELS, mightex_frame_pixels(f[i]), size) ||
+        !mightex_frame_filtered(f[i]) ||
+        memcmp(copy + (2 * i + 1) * MTX_PIXELS, mightex_frame_filtered(f[i]),
+               size))
+      ok = 0;
+    mightex_frame_release(f[i]);
+  }
+  free(copy);
+  if (held < HELD_FRAMES || !ok) {
+    fprintf(stderr, "Held frames changed by later reads\n");
+    return 0;
+  }
+
+  t0 = now();
+  for (i = 0; i < n; i++)
+    mightex_frame_release(mightex_frame_hold(m, 0));
+  dt = (now() - t0) / n * 1.0E9;
+  printf("%-18s %9.1f ns/frame, %d frames held\n", "hold and release", dt,
+         held);
+  return ok;
+}
+
+// buffers of the caller's pool: the acquisition thread queue, its transfers,
+// the current frame and the frames held by bench_frames()
+#define POOL_BUFFERS (64 + MTX_MAX_FRAMES + 1 + HELD_FRAMES)
+
+#ifndef _WIN32
+// the acquisition thread starts with a pool of the documented size, the
+// current frame, the queue and the transfers, and not with one buffer less
+static int check_pool_size(mightex_t *m, char *region) {
+  int n = 1 + 64 + MTX_MAX_FRAMES, ok;
+  ok = mightex_set_buffer_pool(
+           m, region, mightex_buffer_pool_size(n - 1, MTX_MAX_FRAMES),
+           MTX_MAX_FRAMES) == MTX_OK &&
+       mightex_acquisition_start(m, 64) != MTX_OK;
+  ok = ok &&
+       mightex_set_buffer_pool(m, region,
+                               mightex_buffer_pool_size(n, MTX_MAX_FRAMES),
+                               MTX_MAX_FRAMES) == MTX_OK &&
+       mightex_acquisition_start(m, 64) == MTX_OK;
+  mightex_acquisition_stop(m);
+  if (!ok)
+    fprintf(stderr, "Buffer pool size differs from the documented one\n");
+  return ok;
+}
+#endif
+
+int main(int argc, char *const argv[]) {
+  int opt, n = 1000, depth = 4, simulated = 0, fast = 0, unplug = 0, done;
+  int kernels = 0, pool = 0;
+  size_t pool_size = mightex_buffer_pool_size(POOL_BUFFERS, MTX_MAX_FRAMES);
+  char *region = NULL;
+  float exp = 0.1, trigger = 0;
+  unsigned long dropped = 0;
+  mightex_auto_exposure_t ae;
+  double t0;
+  mightex_t *m;
+  mightex_open_times_t times;
+
+  mightex_auto_exposure_defaults(&ae);
+  ae.target = 0;
+  while ((opt = getopt(argc, argv, "n:d:e:u:t:a:sfkp?h")) != -1) {
+    switch (opt)
+    {
+    case 'n':
+      n = atoi(optarg);
+      break;
+    case 'd':
+      depth = atoi(optarg);
+      break;
+    case 'e':
+      exp = atof(optarg);
+      break;
+    case 's':
+      simulated = 1;
+      break;
+    case 'f':
+      fast = 1;
+      break;
+    case 'k':
+      kernels = 1;
+      break;
+    case 'p':
+      pool = 1;
+      break;
+    case 'u':
+      unplug = atoi(optarg);
+      break;
+    case 't':
+      trigger = atof(optarg);
+      break;
+    case 'a':
+      ae.target = atoi(optarg);
+      break;
+    case 'h':
+    case '?':
+    #ifdef _WIN32
+    {
+      char basename[_MAX_FNAME];
+      _splitpath_s(argv[0], NULL, 0, NULL, 0, basename, _MAX_FNAME, NULL, 0);
+      printf("%s - based on %s\n", basename, mightex_sw_version());
+    }
+    #else
+      printf("%s - based on %s\n", basename((char *)argv[0]), mightex_sw_version());
+    #endif
+      printf("Options:\
+      \n\t-s:      use the simulated camera\
+      \n\t-f:      open without reset, using the device cache\
+      \n\t-k:      only time the pixel kernels, over 100 times n frames\
+      \n\t-p:      read frames into a buffer pool supplied by the caller\
+      \n\t-n<val>: number of frames per test (default 1000)\
+      \n\t-d<val>: number of transfers in flight when streaming (default 4)\
+      \n\t-e<val>: set exposure time to val msec (min: 0.1)\
+      \n\t-u<val>: unplug the simulated camera for val msec while streaming\
+      \n\t-t<val>: trigger mode, triggering the simulated camera at val Hz\
+      \n\t-a<val>: auto-exposure, aiming at a peak level of val\
+      \n");
+      return 0;
+    default:
+      break;
+    }
+  }
+
+  if (simulated)
+    m = mightex_new_simulated();
+  else if (fast)
+    m = mightex_open(NULL, MTX_OPEN_NO_RESET | MTX_OPEN_CACHE, &times);
+  else
+    m = mightex_open(NULL, MTX_OPEN_DEFAULT, &times);
+  if (!m) {
+    fprintf(stderr,
+            "No Mightex camera detected or unable to connect, exiting.\n");
+    exit(EXIT_FAILURE);
+  }
+  if (!simulated) {
+    printf("Open times (ms): enumerate %.1f, open %.1f, reset %.1f, "
+           "descriptors %.1f, info %.1f, total %.1f\n",
+           times.enumerate, times.open, times.reset, times.descriptors,
+           times.info, times.total);
+  }
+  if (pool) {
+    region = malloc(pool_size);
+    if (!region ||
+#ifndef _WIN32
+        !check_pool_size(m, region) ||
+#endif
+        mightex_set_buffer_pool(m, region, pool_size, MTX_MAX_FRAMES) !=
+            MTX_OK) {
+      mightex_close(m);
+      exit(EXIT_FAILURE);
+    }
+  }
+  mightex_set_exptime(m, exp);
+  if (trigger > 0) {
+    mightex_simulate_trigger(m, trigger);
+    mightex_set_mode(m, MTX_TRIGGER_MODE);
+  } else {
+    mightex_set_mode(m, MTX_NORMAL_MODE);
+  }
+  if (unplug)
+    mightex_set_auto_reconnect(m, 1);
+  if (ae.target > 0 && mightex_set_auto_exposure(m, &ae) != MTX_OK) {
+    mightex_close(m);
+    exit(EXIT_FAILURE);
+  }
+  printf("Exposure time: %.1f ms, %s camera\n", exp,
+         simulated ? "simulated" : "real");
+
+  if (kernels) {
+    done = bench_kernels(m, 100 * n) && bench_roi(m, 100 * n, simulated) &&
+           bench_accumulate(m, 100 * n) && bench_stats(m, 100 * n) &&
+           bench_peaks(m, 100 * n, simulated) && bench_frames(m, 100 * n);
+    mightex_close(m);
+    free(region);
+    return done ? 0 : EXIT_FAILURE;
+  }
+
+  t0 = now();
+  done = bench_sync(m, n);
+  report("sync", done, now() - t0);
+  if (trigger > 0)
+    report_triggers(m, &dropped);
+  if (done < n) {
+    mightex_close(m);
+    exit(EXIT_FAILURE);
+  }
+
+  t0 = now();
+  done = bench_burst(m, n);
+  report("burst", done, now() - t0);
+  if (trigger > 0)
+    report_triggers(m, &dropped);
+
+  t0 = now();
+  done = bench_acquire(m, n);
+  report("acquire", done, now() - t0);
+  if (trigger > 0)
+    report_triggers(m, &dropped);
+  if (done < n) {
+    mightex_close(m);
+    exit(EXIT_FAILURE);
+  }
+
+  t0 = now();
+  done = bench_stream(m, n, depth, unplug);
+  report("stream", done, now() - t0);
+  if (trigger > 0)
+    report_triggers(m, &dropped);
+  if (done < n) {
+    mightex_close(m);
+    exit(EXIT_FAILURE);
+  }
+
+#ifndef _WIN32
+  // off target, for the acquisition thread to bring it back
+  if (ae.target > 0)
+    mightex_set_exptime(m, mightex_exptime(m) / 4);
+  t0 = now();
+  done = bench_thread(m, n, unplug);
+  report("thread", done, now() - t0);
+  if (trigger > 0) {
+    report_triggers(m, &dropped);
+    if (!bench_slow_consumer(m, 100))
+      done = 0;
+    dropped = mightex_dropped_triggers(m);
+  }
+#endif
+
+  if (unplug) {
+    printf("Reconnections: %lu\n", mightex_gap_count(m));
+#ifdef _WIN32
+    if (mightex_gap_count(m) != 1)
+#else
+    if (mightex_gap_count(m) != 2)
+#endif
+      done = 0;
+  }
+
+  if (ae.target > 0 && !check_exposure(m, &ae))
+    done = 0;
+
+  // frames only land in the caller's region
+  if (pool && (mightex_raw_frame_p(m) < (uint16_t *)region ||
+               mightex_raw_frame_p(m) >= (uint16_t *)(region + pool_size))) {
+    fprintf(stderr, "Frame outside of the buffer pool\n");
+    done = 0;
+  }
+
+  mightex_close(m);
+  free(region);
+  return done >= n ? 0 : EXIT_FAILURE;
+}
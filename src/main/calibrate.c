@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <stdint.h>
+#include <getopt.h>
+#else
+#include <unistd.h>
+#include <libgen.h>
+#endif // _WIN32
+#include <math.h>
+#include <mightex1304.h>
+
+#define MAX_EXPTIMES 16
+
+// Set the scene of the simulated camera, or ask the operator to do it
+static void prepare(mightex_t *m, int simulated, mtx_sim_scene_t scene,
+                    const char *msg) {
+  if (simulated) {
+    mightex_simulate_scene(m, scene);
+    return;
+  }
+  fprintf(stderr, "%s, then press Enter\n", msg);
+  getchar();
+}
+
+// Relative standard deviation of a filtered frame, in percent
+static double non_uniformity(mightex_t *m, mightex_filter_t *filter) {
+  int i, n = mightex_pixel_count(m);
+  double mean = 0, var = 0;
+  uint16_t *data = mightex_frame_p(m);
+  mightex_set_filter(m, filter);
+  mightex_apply_filter(m, NULL);
+  for (i = 0; i < n; i++)
+    mean += data[i];
+  mean /= n;
+  for (i = 0; i < n; i++)
+    var += (data[i] - mean) * (data[i] - mean);
+  mightex_reset_filter(m);
+  return mean > 0 ? 100.0 * sqrt(var / (n - 1)) / mean : 0;
+}
+
+int main(int argc, char *const argv[]) {
+  int opt, i, n = 32, simulated = 0, noflat = 0, n_exp = 0, ok = 1;
+  float exp[MAX_EXPTIMES];
+  double before, after;
+  const char *path = "mightex1304.calib";
+  mightex_t *m;
+
+  while ((opt = getopt(argc, argv, "n:e:o:sF?h")) != -1) {
+    switch (opt)
+    {
+    case 'n':
+      n = atoi(optarg);
+      break;
+    case 'e':
+      if (n_exp < MAX_EXPTIMES)
+        exp[n_exp++] = atof(optarg);
+      break;
+    case 'o':
+      path = optarg;
+      break;
+    case 's':
+      simulated = 1;
+      break;
+    case 'F':
+      noflat = 1;
+      break;
+    case 'h':
+    case '?':
+    #ifdef _WIN32
+    {
+      char basename[_MAX_FNAME];
+      _splitpath_s(argv[0], NULL, 0, NULL, 0, basename, _MAX_FNAME, NULL, 0);
+      printf("%s - based on %s\n", basename, mightex_sw_version());
+    }
+    #else
+      printf("%s - based on %s\n", basename((char *)argv[0]), mightex_sw_version());
+    #endif
+      printf("Options:\
+      \n\t-s:      use the simulated camera\
+      \n\t-n<val>: number of frames averaged per table (default 32)\
+      \n\t-e<val>: calibrate at val msec (can be repeated, default 10)\
+      \n\t-o<val>: calibration file (default mightex1304.calib)\
+      \n\t-F:      dark tables only, no flat field\
+      \n");
+      return 0;
+    default:
+      break;
+    }
+  }
+  if (n_exp == 0)
+    exp[n_exp++] = 10;
+
+  m = simulated ? mightex_new_simulated() : mightex_new();
+  if (!m) {
+    fprintf(stderr,
+            "No Mightex camera detected or unable to connect, exiting.\n");
+    exit(EXIT_FAILURE);
+  }
+  mightex_set_mode(m, MTX_NORMAL_MODE);
+
+  prepare(m, simulated, MTX_SCENE_DARK, "Cover the sensor");
+  for (i = 0; i < n_exp && ok; i++) {
+    mightex_set_exptime(m, exp[i]);
+    ok = mightex_calibrate_dark(m, n) == MTX_OK;
+    fprintf(stderr, "Dark table at %.1f ms: %s\n", exp[i], ok ? "ok" : "failed");
+  }
+
+  if (!noflat && ok) {
+    prepare(m, simulated, MTX_SCENE_FLAT, "Lighten the sensor uniformly");
+    for (i = 0; i < n_exp && ok; i++) {
+      mightex_set_exptime(m, exp[i]);
+      ok = mightex_calibrate_flat(m, n) == MTX_OK;
+      fprintf(stderr, "Gain table at %.1f ms: %s\n", exp[i],
+              ok ? "ok" : "failed");
+      if (!ok)
+        break;
+      // compare the default filter with the calibrated one on a new frame
+      while (mightex_wait_frame(m, 1000) == 0)
+        ;
+      mightex_read_frame(m);
+      before = non_uniformity(m, NULL);
+      after = non_uniformity(m, mightex_filter_calibrated);
+      fprintf(stderr, "Non-uniformity at %.1f ms: %.2f%% -> %.2f%%\n", exp[i],
+              before, after);
+      // the simulated camera has a 5% PRNU and little noise
+      if (simulated && after > before / 4)
+        ok = 0;
+    }
+  }
+
+  if (ok) {
+    ok = mightex_calibration_save(m, path) == MTX_OK;
+    // read it back, as done at startup
+    mightex_calibration_clear(m);
+    ok = ok && mightex_calibration_load(m, path) == MTX_OK &&
+         mightex_calibration_count(m) == n_exp;
+    fprintf(stderr, "Saved %d tables to %s: %s\n", n_exp, path,
+            ok ? "ok" : "failed");
+  }
+
+  mightex_close(m);
+  return ok ? 0 : EXIT_FAILURE;
+}
@@ -7,46 +7,15 @@
 #include <unistd.h>
 #include <libgen.h>
 #endif // _WIN32
-#include <math.h>
 #include <mightex1304.h>
 
-struct stats {
-  double avg, std;
-  uint16_t min, max;
-};
-
-static double mean(uint16_t *const d, uint16_t len) {
-  uint16_t i;
-  uint32_t sum = 0;
-  for (i = 0; i < len; i++) {
-    sum += d[i];
-  }
-  return (double)sum / len;
-}
-
-static double stdev(mightex_t *m, uint16_t *const data, uint16_t len,
-                    void *ud) {
-  uint16_t i;
-  struct stats *s = (struct stats *)ud;
-  s->avg = mean(data, len);
-  s->min = data[0];
-  s->max = data[0];
-  for (i = 0; i < len; i++) {
-    s->min = s->min < data[i] ? s->min: data[i];
-    s->max = s->max > data[i] ? s->max: data[i];
-    s->std += pow(data[i] - s->avg, 2);
-  }
-  s->std = sqrt(s->std / len - 1);
-  return s->std;
-}
-
 int main(int argc, char *const argv[]) {
   int n, i;
   uint16_t *raw_data;
   uint16_t *data;
   int opt, nodata = 0, nofilter = 0;
   float exp = 0.1;
-  struct stats stats;
+  mightex_stats_t stats = {0};
 
   while ((opt = getopt(argc, argv, "e:nr?h")) != -1) {
     switch (opt)
@@ -90,8 +59,8 @@ int main(int argc, char *const argv[]) {
     exit(EXIT_FAILURE);
   }
 
-  // use custom estimator for calculating standard deviation of dark scene
-  mightex_set_estimator(m, stdev);
+  // use the statistics estimator for the standard deviation of dark scene
+  mightex_set_estimator(m, mightex_estimator_stats);
 
   if (nofilter) {
     mightex_set_filter(m, NULL);
@@ -106,17 +75,13 @@ int main(int argc, char *const argv[]) {
     fprintf(stderr, "Failed setting mode\n");
   }
 
-  // Setup data pointers
-  raw_data = mightex_raw_frame_p(m);
-  data = mightex_frame_p(m);
-
   // wait for a frame to be available
-  while ((n = mightex_get_buffer_count(m)) <= 0) {
-#ifdef _WIN32
-    Sleep(10);
-#else
-    usleep(10000);
-#endif
+  while ((n = mightex_wait_frame(m, 1000)) == 0)
+    ;
+  if (n < 0) {
+    fprintf(stderr, "Error waiting for a frame\n");
+    mightex_close(m);
+    exit(EXIT_FAILURE);
   }
 
   // read the frame
@@ -124,10 +89,15 @@ int main(int argc, char *const argv[]) {
   mightex_apply_filter(m, NULL);
   mightex_apply_estimator(m, &stats);
 
+  // data pointers of the frame just read
+  raw_data = mightex_raw_frame_p(m);
+  data = mightex_frame_p(m);
+
   fprintf(stderr, "Dark current level: %d\n", mightex_dark_mean(m));
-  fprintf(stderr, "Mean value: %f\n", stats.avg);
+  fprintf(stderr, "Mean value: %f\n", stats.mean);
   fprintf(stderr, "Std.dev.: %f\n", stats.std);
   fprintf(stderr, "Range: %d - %d\n", stats.min, stats.max);
+  fprintf(stderr, "Saturated pixels: %u\n", stats.saturated);
 
   // print frame data
   if (! nodata) {
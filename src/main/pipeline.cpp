@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <stdint.h>
+#include <getopt.h>
+#else
+#include <unistd.h>
+#include <libgen.h>
+#include <time.h>
+#endif // _WIN32
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+#include <mightex.hh>
+
+// the camera connection can be moved, not copied
+static_assert(!std::is_copy_constructible<Mightex1304>::value &&
+                  std::is_move_constructible<Mightex1304>::value,
+              "Mightex1304 must be move-only");
+static_assert(!std::is_copy_constructible<Frame>::value &&
+                  std::is_move_constructible<Frame>::value,
+              "Frame must be move-only");
+
+static double now(void) {
+#ifdef _WIN32
+  LARGE_INTEGER f, t;
+  QueryPerformanceFrequency(&f);
+  QueryPerformanceCounter(&t);
+  return (double)t.QuadPart / (double)f.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1.0E9;
+#endif
+}
+
+// The same stages as C filter and estimator, as an application would write
+// them before pipelines
+static void filter_threshold(mightex_t *m, uint16_t *const data, uint16_t len,
+                             void *ud) {
+  uint16_t dark = mightex_dark_mean(m), thr = dark * 3;
+  for (int i = 0; i < len; i++) {
+    data[i] = data[i] < dark ? 0 : data[i] - dark;
+    data[i] = data[i] < thr ? 0 : data[i];
+  }
+}
+
+static double estimator_centroid(mightex_t *m, uint16_t *const data,
+                                 uint16_t len, void *ud) {
+  uint64_t num = 0, den = 0;
+  for (int i = 0; i < len; i++) {
+    num += (uint32_t)i * data[i];
+    den += data[i];
+  }
+  return (double)num / (double)den;
+}
+
+// time per frame (ns) of Mightex1304::process(), with the pipeline set or not
+static double time_process(Mightex1304 &cam, int n, double *result) {
+  int i;
+  double t0 = now();
+  for (i = 0; i < n; i++)
+    *result = cam.process();
+  return (now() - t0) / n * 1.0E9;
+}
+
+static void report(const char *name, double ref, double lib) {
+  printf("%-18s %9.1f ns/frame, %9.1f ns/frame (function pointers): "
+         "%5.2fx\n",
+         name, lib, ref, ref / lib);
+}
+
+int main(int argc, char *const argv[]) {
+  int opt, n = 100000, simulated = 0, ok = 1;
+  size_t size = MTX_PIXELS * sizeof(uint16_t);
+  uint16_t ref[MTX_PIXELS];
+  double t_def, t_ref, t_lib, x_def = 0, x_ref = 0, x_lib = 0;
+
+  while ((opt = getopt(argc, argv, "n:s?h")) != -1) {
+    switch (opt)
+    {
+    case 'n':
+      n = atoi(optarg);
+      break;
+    case 's':
+      simulated = 1;
+      break;
+    case 'h':
+    case '?':
+    #ifdef _WIN32
+    {
+      char basename[_MAX_FNAME];
+      _splitpath_s(argv[0], NULL, 0, NULL, 0, basename, _MAX_FNAME, NULL, 0);
+      printf("%s - based on %s\n", basename, mightex_sw_version());
+    }
+    #else
+      printf("%s - based on %s\n", basename((char *)argv[0]), mightex_sw_version());
+    #endif
+      printf("Options:\
+      \n\t-s:      use the simulated camera\
+      \n\t-n<val>: number of runs (default 100000)\
+      \n");
+      return 0;
+    default:
+      break;
+    }
+  }
+
+  Mightex1304 cam(simulated);
+  mightex_t *m = cam.handle();
+  if (!m) {
+    fprintf(stderr,
+            "No Mightex camera detected or unable to connect, exiting.\n");
+    exit(EXIT_FAILURE);
+  }
+  cam.set_mode(MTX_NORMAL_MODE);
+  cam.set_exptime(10);
+  while (mightex_wait_frame(m, 1000) == 0)
+    ;
+  if (cam.read_frame() != MTX_OK)
+    exit(EXIT_FAILURE);
+
+  // the default filter and estimator, hand-vectorized and fused in C
+  t_def = time_process(cam, n, &x_def);
+  // the same stages, through function pointers
+  cam.set_filter(filter_threshold);
+  cam.set_estimator(estimator_centroid);
+  t_ref = time_process(cam, n, &x_ref);
+  FrameView view = cam.frame_view();
+  std::copy(view.begin(), view.end(), ref);
+  cam.reset_filter();
+  cam.reset_estimator();
+
+  // and fused at compile time
+  Pipeline<DarkSub, Threshold, Centroid> centroid;
+  cam.set_pipeline(centroid);
+  t_lib = time_process(cam, n, &x_lib);
+  report("centroid", t_ref, t_lib);
+  printf("%-18s %9.1f ns/frame (%s)\n", "library default", t_def,
+         mightex_simd());
+  if (memcmp(&x_def, &x_lib, sizeof(double)) != 0 ||
+      memcmp(&x_ref, &x_lib, sizeof(double)) != 0) {
+    fprintf(stderr, "Centroids differ: %.17g vs. %.17g\n", x_ref, x_lib);
+    ok = 0;
+  }
+  if (memcmp(ref, mightex_frame_p(m), size) != 0) {
+    fprintf(stderr, "Filtered frames differ\n");
+    ok = 0;
+  }
+
+  // without a filter, the output goes to the view all the same, and the raw
+  // frame is left alone
+  std::vector<uint16_t> raw(cam.raw_frame_view().begin(),
+                            cam.raw_frame_view().end());
+  cam.set_filter(NULL);
+  x_lib = cam.process();
+  if (memcmp(raw.data(), mightex_raw_frame_p(m), size) != 0 ||
+      memcmp(ref, mightex_frame_p(m), size) != 0 ||
+      memcmp(&x_ref, &x_lib, sizeof(double)) != 0) {
+    fprintf(stderr, "Pipeline without a filter overwrote the raw frame\n");
+    ok = 0;
+  }
+  cam.reset_filter();
+
+  // a held frame is moved around, and outlives the next read
+  Frame held = cam.hold_frame();
+  Frame moved = std::move(held);
+  Frame shared = moved.share();
+  while (mightex_wait_frame(m, 1000) == 0)
+    ;
+  if (held || cam.read_frame() != MTX_OK ||
+      moved.raw().data() == cam.raw_frame_view().data() ||
+      memcmp(ref, moved.filtered().data(), size) != 0 ||
+      shared.raw().data() != moved.raw().data()) {
+    fprintf(stderr, "Held frame not preserved\n");
+    ok = 0;
+  }
+
+  // with windows, the same spans are filtered, the rest is the raw frame,
+  // and the centroid of window 0 is tracked as by the library
+  mightex_roi_t roi[3] = {{1700, 256}, {1600, 150}, {100, 64}}, w_def, w_lib;
+  std::vector<uint16_t> out(MTX_PIXELS);
+  cam.reset_pipeline();
+  cam.set_filter(filter_threshold);
+  mightex_set_roi(m, roi, 3);
+  mightex_set_roi_tracking(m, 1);
+  x_def = cam.process();
+  cam.reset_filter();
+  std::copy(mightex_frame_p(m), mightex_frame_p(m) + MTX_PIXELS, out.begin());
+  mightex_roi(m, &w_def, 1);
+  mightex_set_roi(m, roi, 3);
+  mightex_set_roi_tracking(m, 1);
+  cam.set_pipeline(centroid);
+  x_lib = cam.process();
+  mightex_roi(m, &w_lib, 1);
+  if (memcmp(&x_def, &x_lib, sizeof(double)) != 0 ||
+      memcmp(out.data(), mightex_frame_p(m), size) != 0 ||
+      w_def.start != w_lib.start) {
+    fprintf(stderr, "Pipeline over windows differs: %.17g vs. %.17g\n",
+            x_def, x_lib);
+    ok = 0;
+  }
+  mightex_set_roi(m, NULL, 0);
+
+  // another chain, with a configured stage
+  Pipeline<DarkSub, Threshold, Maximum> peak(DarkSub(), Threshold(1000),
+                                             Maximum());
+  cam.set_pipeline(peak);
+  t_lib = time_process(cam, n, &x_lib);
+  printf("%-18s %9.1f ns/frame\n", "maximum", t_lib);
+  printf("Centroid at %.2f, maximum at %.0f\n", x_ref, x_lib);
+  // the simulated spot is symmetric around the sensor center
+  if (simulated && (x_lib < x_ref - 1 || x_lib > x_ref + 1))
+    ok = 0;
+
+  cam.reset_pipeline();
+  return ok ? 0 : EXIT_FAILURE;
+}
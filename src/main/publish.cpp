@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <stdint.h>
+#include <getopt.h>
+#else
+#include <unistd.h>
+#include <libgen.h>
+#include <time.h>
+#include <sys/wait.h>
+#endif // _WIN32
+#include <mightex.hh>
+
+#define MAX_CONSUMERS 16
+
+static double now(void) {
+#ifdef _WIN32
+  LARGE_INTEGER f, t;
+  QueryPerformanceFrequency(&f);
+  QueryPerformanceCounter(&t);
+  return (double)t.QuadPart / (double)f.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1.0E9;
+#endif
+}
+
+// Read the frames published from first on, as a separate process would, until
+// frame last; with last at 0, until no frame comes for a while
+static int consume(const char *name, uint64_t first, uint64_t last, int id) {
+  FrameRing ring(name);
+  uint64_t prev = 0, n = 0;
+  double t0 = now();
+  if (!ring.is_open())
+    return EXIT_FAILURE;
+  if (last)
+    ring.seek(first);
+  while (ring.next(2000)) {
+    if ((n > 0 && ring.index() <= prev) || ring.dark_mean() == 0) {
+      fprintf(stderr, "Consumer %d: bad frame %llu\n", id, ring.index());
+      return EXIT_FAILURE;
+    }
+    prev = ring.index();
+    n++;
+    if (last && prev >= last)
+      break;
+    if (!last && n % 1000 == 0)
+      fprintf(stderr, "Frame %llu: %.0f frames/s, %llu skipped\n",
+              (unsigned long long)prev, n / (now() - t0), ring.skipped());
+  }
+  fprintf(stderr, "Consumer %d: %llu frames read, %llu skipped: %s\n", id,
+          (unsigned long long)n, ring.skipped(),
+          !last || prev >= last ? "ok" : "failed");
+  return !last || prev >= last ? 0 : EXIT_FAILURE;
+}
+
+int main(int argc, char *const argv[]) {
+  int opt, i, n = 1000, consumers = 3, simulated = 0, subscribe = 0, ok = 1;
+  const char *name = "/mightex1304";
+  uint64_t first;
+
+  while ((opt = getopt(argc, argv, "n:c:o:sr?h")) != -1) {
+    switch (opt)
+    {
+    case 'n':
+      n = atoi(optarg);
+      break;
+    case 'c':
+      consumers = atoi(optarg);
+      break;
+    case 'o':
+      name = optarg;
+      break;
+    case 's':
+      simulated = 1;
+      break;
+    case 'r':
+      subscribe = 1;
+      break;
+    case 'h':
+    case '?':
+    #ifdef _WIN32
+    {
+      char basename[_MAX_FNAME];
+      _splitpath_s(argv[0], NULL, 0, NULL, 0, basename, _MAX_FNAME, NULL, 0);
+      printf("%s - based on %s\n", basename, mightex_sw_version());
+    }
+    #else
+      printf("%s - based on %s\n", basename((char *)argv[0]), mightex_sw_version());
+    #endif
+      printf("Options:\
+      \n\t-s:      use the simulated camera\
+      \n\t-n<val>: number of frames published (default 1000)\
+      \n\t-c<val>: number of consumer processes (default 3, max 16)\
+      \n\t-o<val>: shared memory name (default /mightex1304)\
+      \n\t-r:      only read the frames published by another process\
+      \n");
+      return 0;
+    default:
+      break;
+    }
+  }
+  if (subscribe)
+    return consume(name, 0, 0, 0);
+#ifdef _WIN32
+  fprintf(stderr, "Consumer processes not supported on this platform\n");
+  return EXIT_FAILURE;
+#else
+  pid_t pids[MAX_CONSUMERS];
+  int status;
+  if (n < 2 || consumers < 0 || consumers > MAX_CONSUMERS)
+    exit(EXIT_FAILURE);
+
+  Mightex1304 cam(simulated);
+  mightex_t *m = cam.handle();
+  if (!m) {
+    fprintf(stderr,
+            "No Mightex camera detected or unable to connect, exiting.\n");
+    exit(EXIT_FAILURE);
+  }
+  cam.set_mode(MTX_NORMAL_MODE);
+  cam.set_exptime(1);
+  if (cam.publish(name, 256) != MTX_OK)
+    exit(EXIT_FAILURE);
+  FrameRing ring(name);
+  first = ring.count();
+  for (i = 0; i < consumers; i++) {
+    pids[i] = fork();
+    if (pids[i] == 0)
+      _exit(consume(name, first, first + n - 1, i + 1));
+  }
+
+  // frames read one at a time are published before the read returns
+  for (i = 0; i < n / 2 && ok; i++) {
+    while (mightex_wait_frame(m, 1000) == 0)
+      ;
+    ok = cam.read_frame() == MTX_OK && ring.next(0) &&
+         memcmp(ring.frame_view().data(), cam.raw_frame_view().data(),
+                MTX_PIXELS * sizeof(uint16_t)) == 0;
+  }
+  // frames of the acquisition thread as they arrive
+  if (ok && mightex_acquisition_start(m, 64) == MTX_OK) {
+    for (; i < n && ok; i++)
+      ok = mightex_pop_frame(m, 1000) == MTX_OK;
+    mightex_acquisition_stop(m);
+  }
+  fprintf(stderr, "Published %d frames: %s\n", i, ok ? "ok" : "failed");
+
+  for (i = 0; i < consumers; i++)
+    ok = pids[i] > 0 && waitpid(pids[i], &status, 0) == pids[i] &&
+         WIFEXITED(status) && WEXITSTATUS(status) == 0 && ok;
+  return ok ? 0 : EXIT_FAILURE;
+#endif
+}
@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <stdint.h>
+#include <getopt.h>
+#else
+#include <unistd.h>
+#include <libgen.h>
+#include <signal.h>
+#include <sys/wait.h>
+#endif // _WIN32
+#include <mightex1304.h>
+
+#define CRASH_FRAMES 50
+
+static uint32_t checksum(const uint16_t *data) {
+  int i;
+  uint32_t sum = 0;
+  for (i = 0; i < MTX_PIXELS; i++)
+    sum = sum * 31 + data[i];
+  return sum;
+}
+
+// Print what a ring holds, as after a crash
+static int summary(const char *path) {
+  uint64_t i, count, first;
+  unsigned long valid = 0, missed = 0;
+  uint16_t meta[MTX_META_VALUES], t0 = 0, t1 = 0;
+  mightex_ring_t *r = mightex_ring_open(path);
+  if (!r)
+    return EXIT_FAILURE;
+  count = mightex_ring_count(r);
+  first = count > (uint64_t)mightex_ring_capacity(r)
+              ? count - mightex_ring_capacity(r)
+              : 0;
+  for (i = first; i < count; i++) {
+    if (mightex_ring_read(r, i, NULL, meta) != MTX_OK)
+      continue;
+    if (valid++ == 0)
+      t0 = meta[MTX_META_TIMESTAMP];
+    t1 = meta[MTX_META_TIMESTAMP];
+    missed += meta[MTX_META_MISSED];
+  }
+  printf("%s: %llu frames recorded, %lu of the last %llu readable, "
+         "timestamps %u to %u ms, %lu triggers missed\n",
+         path, (unsigned long long)count, valid,
+         (unsigned long long)(count - first), t0, t1, missed);
+  mightex_ring_close(r);
+  return 0;
+}
+
+// Check that the frames base to base + n - 1 read the sums recorded for them,
+// as long as they are still in the ring, and that the older ones are gone
+static int verify(mightex_ring_t *r, uint64_t base, int n,
+                  const uint32_t *sums) {
+  int i, cap = mightex_ring_capacity(r);
+  uint16_t data[MTX_PIXELS];
+  if (mightex_ring_count(r) != base + n)
+    return 0;
+  for (i = 0; i < n; i++) {
+    mtx_result_t rc = mightex_ring_read(r, base + i, data, NULL);
+    if (i < n - cap ? rc == MTX_OK
+                    : rc != MTX_OK || checksum(data) != sums[i])
+      return 0;
+  }
+  return mightex_ring_read(r, base + n, data, NULL) != MTX_OK;
+}
+
+#ifndef _WIN32
+// Record some frames in another process, which then gets killed: those frames
+// shall be in the ring, and the ring writable again
+static int crash(const char *path, int cap) {
+  int i, status, ok;
+  uint64_t count;
+  mightex_ring_t *r, *w;
+  pid_t pid;
+  // before the child starts writing
+  r = mightex_ring_open(path);
+  count = r ? mightex_ring_count(r) : 0;
+  mightex_ring_close(r);
+  pid = fork();
+  if (pid == 0) {
+    mightex_t *m = mightex_new_simulated();
+    w = mightex_ring_create(path, cap);
+    if (!m || !w || mightex_set_recorder(m, w) != MTX_OK)
+      _exit(EXIT_FAILURE);
+    mightex_set_exptime(m, 1);
+    for (i = 0; i < CRASH_FRAMES; i++) {
+      while (mightex_wait_frame(m, 1000) == 0)
+        ;
+      mightex_read_frame(m);
+    }
+    kill(getpid(), SIGKILL);
+    _exit(EXIT_FAILURE);
+  }
+  if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFSIGNALED(status))
+    return 0;
+  r = mightex_ring_open(path);
+  ok = r && mightex_ring_count(r) == count + CRASH_FRAMES;
+  for (i = 0; ok && i < CRASH_FRAMES && i < cap; i++)
+    ok = mightex_ring_read(r, count + CRASH_FRAMES - 1 - i, NULL, NULL) ==
+         MTX_OK;
+  mightex_ring_close(r);
+  w = mightex_ring_create(path, cap);
+  ok = ok && w && mightex_ring_count(w) == count + CRASH_FRAMES;
+  mightex_ring_close(w);
+  return ok;
+}
+#endif
+
+int main(int argc, char *const argv[]) {
+  int opt, i, n = 500, cap = 256, simulated = 0, readonly = 0, ok = 1;
+  unsigned long valid = 0;
+  uint64_t base, c;
+  uint32_t *sums;
+  uint16_t data[MTX_PIXELS];
+  const char *path = "mightex1304.ring";
+  mightex_ring_t *w, *r;
+  mightex_t *m;
+
+  while ((opt = getopt(argc, argv, "n:c:o:sr?h")) != -1) {
+    switch (opt)
+    {
+    case 'n':
+      n = atoi(optarg);
+      break;
+    case 'c':
+      cap = atoi(optarg);
+      break;
+    case 'o':
+      path = optarg;
+      break;
+    case 's':
+      simulated = 1;
+      break;
+    case 'r':
+      readonly = 1;
+      break;
+    case 'h':
+    case '?':
+    #ifdef _WIN32
+    {
+      char basename[_MAX_FNAME];
+      _splitpath_s(argv[0], NULL, 0, NULL, 0, basename, _MAX_FNAME, NULL, 0);
+      printf("%s - based on %s\n", basename, mightex_sw_version());
+    }
+    #else
+      printf("%s - based on %s\n", basename((char *)argv[0]), mightex_sw_version());
+    #endif
+      printf("Options:\
+      \n\t-s:      use the simulated camera\
+      \n\t-n<val>: number of frames recorded (default 500)\
+      \n\t-c<val>: ring capacity, in frames (default 256)\
+      \n\t-o<val>: ring file (default mightex1304.ring)\
+      \n\t-r:      only print what the ring file holds\
+      \n");
+      return 0;
+    default:
+      break;
+    }
+  }
+  if (readonly)
+    return summary(path);
+  if (n < 1 || cap < 1)
+    exit(EXIT_FAILURE);
+
+  m = simulated ? mightex_new_simulated() : mightex_new();
+  if (!m) {
+    fprintf(stderr,
+            "No Mightex camera detected or unable to connect, exiting.\n");
+    exit(EXIT_FAILURE);
+  }
+  mightex_set_mode(m, MTX_NORMAL_MODE);
+  mightex_set_exptime(m, 1);
+  sums = malloc(n * sizeof(uint32_t));
+  w = mightex_ring_create(path, cap);
+  // a reader can map the ring while it is being written
+  r = w ? mightex_ring_open(path) : NULL;
+  if (!sums || !r || mightex_set_recorder(m, w) != MTX_OK) {
+    mightex_close(m);
+    exit(EXIT_FAILURE);
+  }
+
+  // frames read one at a time
+  base = mightex_ring_count(r);
+  for (i = 0; i < n; i++) {
+    while (mightex_wait_frame(m, 1000) == 0)
+      ;
+    mightex_read_frame(m);
+    sums[i] = checksum(mightex_raw_frame_p(m));
+  }
+  ok = verify(r, base, n, sums);
+  fprintf(stderr, "Read %d frames into a ring of %d: %s\n", n, cap,
+          ok ? "ok" : "failed");
+
+  // frames recorded by the acquisition thread, read back while recording
+  base = mightex_ring_count(r);
+  if (ok && mightex_acquisition_start(m, 64) == MTX_OK) {
+    for (i = 0; i < n; i++) {
+      if (mightex_pop_frame(m, 1000) != MTX_OK)
+        break;
+      c = mightex_ring_count(r);
+      if (c > base && mightex_ring_read(r, c - 1, data, NULL) == MTX_OK)
+        valid++;
+    }
+    mightex_acquisition_stop(m);
+    ok = i == n && mightex_ring_count(r) >= base + n && valid > 0;
+    fprintf(stderr, "Streamed %d frames, %lu read back while recording: %s\n",
+            i, valid, ok ? "ok" : "failed");
+  }
+  mightex_set_recorder(m, NULL);
+  mightex_ring_close(w);
+  mightex_ring_close(r);
+  mightex_close(m);
+  free(sums);
+
+#ifndef _WIN32
+  if (ok) {
+    ok = crash(path, cap);
+    fprintf(stderr, "Recorded %d frames in a process killed: %s\n",
+            CRASH_FRAMES, ok ? "ok" : "failed");
+  }
+#endif
+  if (ok)
+    summary(path);
+  return ok ? 0 : EXIT_FAILURE;
+}
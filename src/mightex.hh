@@ -31,6 +31,8 @@
 %include "std_vector.i"
 namespace std {
   %template(VecInt) vector<int>;
+  %template(VecUInt) vector<unsigned int>;
+  %template(VecDouble) vector<double>;
 };
 #endif
 
@@ -43,6 +45,9 @@ namespace std {
                    
 #include <string>
 #include <vector>
+#include <utility>
+#include <math.h>
+#include <stdint.h>
 
 #include "mightex1304.h"
 
@@ -54,6 +59,364 @@ namespace std {
  */
 std::string version() { return mightex_sw_version(); }
 
+#ifndef SWIG
+//   ____  _            _ _            
+//  |  _ \(_)_ __   ___| (_)_ __   ___ 
+//  | |_) | | '_ \ / _ \ | | '_ \ / _ \
+//  |  __/| | |_) |  __/ | | | | |  __/
+//  |_|   |_| .__/ \___|_|_|_| |_|\___|
+//          |_|                        
+
+/**
+ * @name Pipeline stages
+ * @brief Policy types to be composed in a @ref Pipeline
+ * 
+ * A stage derives from @ref PipelineStage and has an `apply(uint16_t value, 
+ * int index)` method, returning the value passed to the next stage. The last
+ * stage of a pipeline is the estimator: it also has a `result()` method, 
+ * returning a `double`.
+ */
+/**@{*/
+
+/**
+ * @brief Base of the pipeline stages, with the optional methods
+ */
+struct PipelineStage {
+  /**
+   * @brief Called once per frame, before the first pixel
+   */
+  void begin(mightex_t *) {}
+
+  /**
+   * @brief Called every @ref MTX_PIPELINE_BLOCK pixels, and after the last
+   * 
+   * Lets estimators keep narrow accumulators, which vectorize better, and 
+   * move them to wider ones once per block. Takes the index of the next 
+   * pixel.
+   */
+  void flush(int) {}
+};
+
+/**
+ * @brief Number of pixels between two calls to the `flush()` method of the 
+ * stages
+ * 
+ * Sums of 256 products of a 16-bit value and an index within the block fit 
+ * in 32 bits.
+ */
+#define MTX_PIPELINE_BLOCK 256
+
+/**
+ * @brief Subtract the mean of the shielded pixels, as the default filter
+ */
+struct DarkSub : PipelineStage {
+  uint16_t dark = 0;
+  void begin(mightex_t *m) { dark = mightex_dark_mean(m); }
+  uint16_t apply(uint16_t v, int) const { return v < dark ? 0 : v - dark; }
+};
+
+/**
+ * @brief Zero the values below a level
+ * 
+ * With a level of 0, the level is three times the dark mean, as for the 
+ * default estimator.
+ */
+struct Threshold : PipelineStage {
+  uint16_t level, thr = 0;
+  Threshold(uint16_t level = 0) : level(level) {}
+  void begin(mightex_t *m) {
+    thr = level ? level : mightex_dark_mean(m) * 3;
+  }
+  uint16_t apply(uint16_t v, int) const { return v < thr ? 0 : v; }
+};
+
+/**
+ * @brief Centroid of the values, as the default estimator
+ * 
+ * Sums are integers, so that `Pipeline<DarkSub, Threshold, Centroid>` 
+ * returns exactly the same value as @ref mightex_process with the default 
+ * filter and estimator.
+ */
+struct Centroid : PipelineStage {
+  uint64_t num = 0, den = 0;
+  uint32_t block_num = 0, block_den = 0;
+  int start = 0; // of the block
+  void begin(mightex_t *) { num = den = block_num = block_den = start = 0; }
+  uint16_t apply(uint16_t v, int i) {
+    block_num += (uint32_t)(uint16_t)(i - start) * v;
+    block_den += v;
+    return v;
+  }
+  void flush(int next) {
+    num += block_num + (uint64_t)start * block_den;
+    den += block_den;
+    block_num = block_den = 0;
+    start = next;
+  }
+  double result() const { return (double)num / (double)den; }
+};
+
+/**
+ * @brief Index of the highest value (the first one, on ties)
+ */
+struct Maximum : PipelineStage {
+  uint16_t max = 0;
+  int at = 0;
+  void begin(mightex_t *) { max = 0, at = 0; }
+  uint16_t apply(uint16_t v, int i) {
+    if (v > max)
+      max = v, at = i;
+    return v;
+  }
+  double result() const { return at; }
+};
+/**@}*/
+
+// Chain of stages, each one passing its output to the next; the result is
+// the one of the last stage
+template <class... Stages> struct PipelineChain;
+
+template <class Last> struct PipelineChain<Last> {
+  Last stage;
+  PipelineChain() = default;
+  PipelineChain(const Last &last) : stage(last) {}
+  void begin(mightex_t *m) { stage.begin(m); }
+  void flush(int next) { stage.flush(next); }
+  uint16_t apply(uint16_t v, int i) { return stage.apply(v, i); }
+  double result() const { return stage.result(); }
+};
+
+template <class First, class... Rest> struct PipelineChain<First, Rest...> {
+  First stage;
+  PipelineChain<Rest...> rest;
+  PipelineChain() = default;
+  PipelineChain(const First &first, const Rest &...others)
+      : stage(first), rest(others...) {}
+  void begin(mightex_t *m) {
+    stage.begin(m);
+    rest.begin(m);
+  }
+  void flush(int next) {
+    stage.flush(next);
+    rest.flush(next);
+  }
+  uint16_t apply(uint16_t v, int i) { return rest.apply(stage.apply(v, i), i); }
+  double result() const { return rest.result(); }
+};
+
+/**
+ * @brief Filters and estimator composed at compile time
+ * 
+ * The stages (see @ref DarkSub and the following) are inlined into a single 
+ * loop over the raw frame, which writes the output of the last filter to 
+ * @ref mightex_frame_output and feeds the estimator: there is neither an indirect
+ * call per stage, nor a pass over the frame per stage. For example:
+ * 
+ * ```cpp
+ * Pipeline<DarkSub, Threshold, Centroid> centroid;
+ * Pipeline<DarkSub, Threshold, Maximum> peak(DarkSub(), Threshold(1000), 
+ *                                           Maximum());
+ * double x = centroid.run(m);
+ * ```
+ * 
+ * Like @ref mightex_process, it always starts from the raw frame, filters 
+ * the windows set with @ref mightex_set_roi, estimates over window 0 and 
+ * feeds the result to the tracking; without windows, it works on the whole
+ * frame.
+ * 
+ * @tparam Stages the filters, then the estimator
+ */
+template <class... Stages> class Pipeline {
+public:
+  Pipeline() = default;
+
+  /**
+   * @brief Construct a new Pipeline object from configured stages
+   */
+  explicit Pipeline(const Stages &...stages) : _chain(stages...) {}
+
+  /**
+   * @brief Process the current frame
+   * 
+   * @param m 
+   * @return double the result of the estimator
+   */
+  double run(mightex_t *m) {
+    const uint16_t *raw = mightex_raw_frame_p(m);
+    uint16_t *data = mightex_frame_output(m);
+    mightex_roi_t spans[MTX_MAX_ROI], w = {0, 0};
+    int i, n = mightex_roi_spans(m, spans), start, end;
+    if (!data)
+      return NAN;
+    if (mightex_roi(m, &w, 1) == 0 || mightex_roi_searching(m))
+      w = spans[0];
+    // a local copy keeps the state of the stages in registers; the estimator
+    // only sees window 0, the other windows go through a copy of the chain
+    // whose result is dropped
+    PipelineChain<Stages...> chain = _chain;
+    chain.begin(m);
+    PipelineChain<Stages...> others = chain;
+    for (i = 0; i < n; i++) {
+      start = spans[i].start;
+      end = start + spans[i].width;
+      if (w.start >= end || w.start + w.width <= start) {
+        apply(others, raw, data, start, end);
+        continue;
+      }
+      apply(others, raw, data, start, w.start);
+      apply(chain, raw, data, w.start, w.start + w.width);
+      apply(others, raw, data, w.start + w.width, end);
+    }
+    _chain = chain;
+    return mightex_roi_track(m, chain.result());
+  }
+
+  /**
+   * @brief Trampoline to the @ref run method of a pipeline
+   * 
+   * @param pipeline a pointer to the pipeline
+   * @param m 
+   * @return double 
+   */
+  static double run(void *pipeline, mightex_t *m) {
+    return static_cast<Pipeline *>(pipeline)->run(m);
+  }
+
+private:
+  PipelineChain<Stages...> _chain;
+
+  // Pixels [start, end) through the chain, block by block
+  static void apply(PipelineChain<Stages...> &chain,
+                    const uint16_t *__restrict raw, uint16_t *__restrict data,
+                    int start, int end) {
+    int i, j;
+    if (start >= end)
+      return;
+    chain.flush(start);
+    for (i = start; i + MTX_PIPELINE_BLOCK <= end; i += MTX_PIPELINE_BLOCK) {
+      for (j = i; j < i + MTX_PIPELINE_BLOCK; j++)
+        data[j] = chain.apply(raw[j], j);
+      chain.flush(j);
+    }
+    for (; i < end; i++)
+      data[i] = chain.apply(raw[i], i);
+    chain.flush(end);
+  }
+};
+
+//   _____                              
+//  |  ___| __ __ _ _ __ ___   ___  ___ 
+//  | |_ | '__/ _` | '_ ` _ \ / _ \/ __|
+//  |  _|| | | (_| | | | | | |  __/\__ \
+//  |_|  |_|  \__,_|_| |_| |_|\___||___/
+
+/**
+ * @brief Read-only view of the pixels of a frame, without copying them
+ * 
+ * Valid as long as the viewed storage: until the next read for the views 
+ * returned by @ref Mightex1304, as long as the @ref Frame for its views.
+ */
+class FrameView {
+public:
+  FrameView() : _data(nullptr), _size(0) {}
+  FrameView(const uint16_t *data, size_t size) : _data(data), _size(size) {}
+
+  const uint16_t *data() const { return _data; }
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+  const uint16_t &operator[](size_t i) const { return _data[i]; }
+  const uint16_t *begin() const { return _data; }
+  const uint16_t *end() const { return _data + _size; }
+
+private:
+  const uint16_t *_data;
+  size_t _size;
+};
+
+/**
+ * @brief A held frame, owning a reference to its pooled buffer
+ * 
+ * Move-only: the buffer goes back to the pool when the last Frame referring
+ * to it is destroyed. Use @ref share for another reference, e.g. to hand the
+ * frame over to another thread.
+ */
+class Frame {
+public:
+  Frame() : _f(nullptr) {}
+
+  /**
+   * @brief Take over a reference, as returned by @ref mightex_frame_hold
+   */
+  explicit Frame(mightex_frame_t *f) : _f(f) {}
+
+  ~Frame() { mightex_frame_release(_f); }
+
+  Frame(const Frame &) = delete;
+  Frame &operator=(const Frame &) = delete;
+  Frame(Frame &&other) noexcept : _f(other._f) { other._f = nullptr; }
+  Frame &operator=(Frame &&other) noexcept {
+    if (this != &other) {
+      mightex_frame_release(_f);
+      _f = other._f;
+      other._f = nullptr;
+    }
+    return *this;
+  }
+
+  /**
+   * @brief False for an empty (or moved-from) Frame
+   */
+  explicit operator bool() const { return _f != nullptr; }
+
+  /**
+   * @brief Another reference to the same frame
+   */
+  Frame share() const {
+    return Frame(_f ? mightex_frame_retain(_f) : nullptr);
+  }
+
+  /**
+   * @brief Raw pixel values
+   */
+  FrameView raw() const {
+    return _f ? FrameView(mightex_frame_pixels(_f), MTX_PIXELS) : FrameView();
+  }
+
+  /**
+   * @brief Filtered pixel values, empty if the frame was not filtered
+   */
+  FrameView filtered() const {
+    const uint16_t *p = _f ? mightex_frame_filtered(_f) : nullptr;
+    return p ? FrameView(p, MTX_PIXELS) : FrameView();
+  }
+
+  /**
+   * @brief Frame metadata
+   */
+  mightex_frame_meta_t meta() const {
+    mightex_frame_meta_t meta = {};
+    if (_f)
+      mightex_frame_info(_f, &meta);
+    return meta;
+  }
+
+  /**
+   * @brief The mean of the shielded pixels
+   */
+  unsigned int dark_mean() const {
+    return _f ? mightex_frame_dark_mean(_f) : 0;
+  }
+
+  /**
+   * @brief The underlying frame handle
+   */
+  mightex_frame_t *handle() const { return _f; }
+
+private:
+  mightex_frame_t *_f;
+};
+#endif
+
 /**
  * @brief Class wrapping the underlying `mightex` library
  * 
@@ -86,7 +449,29 @@ private:
   mightex_t *m;
   std::string _serial;
   std::string _version;
-  uint16_t *_frame_p, *_raw_frame_p;
+  double (*_run)(void *, mightex_t *) = nullptr;
+  void *_pipeline = nullptr;
+  mightex_ring_t *_publisher = nullptr;
+  std::string _published;
+
+  void init() {
+    if (!m)
+      return;
+    _serial = mightex_serial_no(m);
+    _version = mightex_version(m);
+  }
+
+  // close the camera first, so that nothing is published anymore
+  void close() {
+    if (m)
+      mightex_close(m);
+    m = nullptr;
+    if (_publisher) {
+      mightex_ring_close(_publisher);
+      mightex_ring_remove_shared(_published.c_str());
+      _publisher = nullptr;
+    }
+  }
 
 public:
   /**
@@ -95,17 +480,54 @@ public:
    */
   Mightex1304() {
     m = mightex_new();
-    _frame_p = mightex_frame_p(m);
-    _raw_frame_p = mightex_raw_frame_p(m);
-    _serial = mightex_serial_no(m);
-    _version = mightex_version(m);
+    init();
+  }
+
+  /**
+   * @brief Construct a new Mightex1304 object, possibly on the simulated 
+   * camera
+   * 
+   * @param simulated if true, use the simulated camera
+   */
+  Mightex1304(bool simulated) {
+    m = simulated ? mightex_new_simulated() : mightex_new();
+    init();
   }
 
   /**
    * @brief Close device connection and destroy the Mightex1304 object
    * 
    */
-  ~Mightex1304() { mightex_close(m); }
+  ~Mightex1304() { close(); }
+
+#ifndef SWIG
+  // the device connection is owned by one object only
+  Mightex1304(const Mightex1304 &) = delete;
+  Mightex1304 &operator=(const Mightex1304 &) = delete;
+  Mightex1304(Mightex1304 &&other) noexcept
+      : m(other.m), _serial(std::move(other._serial)),
+        _version(std::move(other._version)), _run(other._run),
+        _pipeline(other._pipeline), _publisher(other._publisher),
+        _published(std::move(other._published)) {
+    other.m = nullptr;
+    other._publisher = nullptr;
+  }
+  Mightex1304 &operator=(Mightex1304 &&other) noexcept {
+    if (this != &other) {
+      close();
+      m = other.m;
+      _serial = std::move(other._serial);
+      _version = std::move(other._version);
+      _run = other._run;
+      _pipeline = other._pipeline;
+      _publisher = other._publisher;
+      _published = std::move(other._published);
+      other.m = nullptr;
+      other._publisher = nullptr;
+    }
+    return *this;
+  }
+#endif
 
   /**
    * @brief Serial number of connected device
@@ -186,22 +608,26 @@ public:
    * @brief Return a vector containing the values of the last frame
    * 
    * Frame values could be possibly filtered, if @ref Mightex1304.apply_filter has
-   * been called previously.
+   * been called previously. Use @ref frame_view to avoid the copy.
    * 
    * @return std::vector<int> 
    */
   std::vector<int> frame() {
-    std::vector<int> data(_frame_p, _frame_p + mightex_pixel_count(m));
+    uint16_t *p = mightex_frame_p(m);
+    std::vector<int> data(p, p + mightex_pixel_count(m));
     return data;
   }
 
   /**
    * @brief Return a vector containing unfiltered values of the last frame
    * 
+   * Use @ref raw_frame_view to avoid the copy.
+   * 
    * @return std::vector<int> 
    */
   std::vector<int> raw_frame() {
-    std::vector<int> data(_raw_frame_p, _raw_frame_p + mightex_pixel_count(m));
+    uint16_t *p = mightex_raw_frame_p(m);
+    std::vector<int> data(p, p + mightex_pixel_count(m));
     return data;
   }
 
@@ -218,6 +644,18 @@ public:
    */
   double apply_estimator() { return mightex_apply_estimator(m, NULL); }
 
+  /**
+   * @brief Filter the current frame and apply the estimator, in one go
+   * 
+   * Runs the pipeline if one is set, else @ref mightex_process with the 
+   * current filter and estimator.
+   * 
+   * @return double 
+   */
+  double process() {
+    return _run ? _run(_pipeline, m) : mightex_process(m, NULL);
+  }
+
   /**
    * @brief Write a value to a GPIO register
    * 
@@ -238,6 +676,44 @@ public:
     return (int)mightex_gpio_read(m, (BYTE)reg);
   }
 
+  /**
+   * @brief Publish each frame read in shared memory, to the @ref FrameRing 
+   * consumers in other processes
+   * 
+   * @param name the shared memory object name, as `/mightex1304`
+   * @param frames the ring capacity, in frames
+   * @return mtx_result_t 
+   * @see mightex_set_publisher
+   */
+  mtx_result_t publish(const std::string &name, int frames = 1024) {
+    if (unpublish() != MTX_OK)
+      return MTX_FAIL;
+    _publisher = mightex_ring_create_shared(name.c_str(), frames);
+    if (!_publisher || mightex_set_publisher(m, _publisher) != MTX_OK) {
+      mightex_ring_close(_publisher);
+      _publisher = nullptr;
+      return MTX_FAIL;
+    }
+    _published = name;
+    return MTX_OK;
+  }
+
+  /**
+   * @brief Stop publishing, and remove the name of the ring
+   * 
+   * @return mtx_result_t MTX_FAIL while streaming
+   */
+  mtx_result_t unpublish() {
+    if (!_publisher)
+      return MTX_OK;
+    if (mightex_set_publisher(m, NULL) != MTX_OK)
+      return MTX_FAIL;
+    mightex_ring_close(_publisher);
+    mightex_ring_remove_shared(_published.c_str());
+    _publisher = nullptr;
+    return MTX_OK;
+  }
+
 #ifndef SWIG
   /**
    * @name Not exposed to SWIG
@@ -305,6 +781,502 @@ public:
    * @note This method is **not exposed** via SWIG.
    */
   void reset_estimator() { mightex_reset_estimator(m); }
+
+  /**
+   * @brief Use a pipeline in place of the filter and the estimator
+   * 
+   * From now on, @ref process runs the pipeline. The pipeline is not copied,
+   * and must outlive this object or be reset.
+   * 
+   * @param p 
+   * @note This method is **not exposed** via SWIG.
+   */
+  template <class... Stages> void set_pipeline(Pipeline<Stages...> &p) {
+    _pipeline = &p;
+    _run = &Pipeline<Stages...>::run;
+  }
+
+  /**
+   * @brief Go back to the filter and the estimator
+   * 
+   * @note This method is **not exposed** via SWIG.
+   */
+  void reset_pipeline() {
+    _pipeline = nullptr;
+    _run = nullptr;
+  }
+
+  /**
+   * @brief The underlying driver handle, for the C functions not wrapped here
+   * 
+   * @return mightex_t* 
+   * @note This method is **not exposed** via SWIG.
+   */
+  mightex_t *handle() { return m; }
+
+  /**
+   * @brief View of the last frame, possibly filtered, without copying it
+   * 
+   * @return FrameView valid until the next read
+   * @note This method is **not exposed** via SWIG.
+   */
+  FrameView frame_view() { return FrameView(mightex_frame_p(m), MTX_PIXELS); }
+
+  /**
+   * @brief View of the raw values of the last frame, without copying them
+   * 
+   * @return FrameView valid until the next read
+   * @note This method is **not exposed** via SWIG.
+   */
+  FrameView raw_frame_view() {
+    return FrameView(mightex_raw_frame_p(m), MTX_PIXELS);
+  }
+
+  /**
+   * @brief Hold the i-th frame of the last read, so that it outlives it
+   * 
+   * @param i frame index, from 0 to @ref mightex_frame_count - 1
+   * @return Frame empty if @p i is out of range
+   * @note This method is **not exposed** via SWIG.
+   */
+  Frame hold_frame(int i = 0) { return Frame(mightex_frame_hold(m, i)); }
+
+  /**
+   * @brief Read n frames into consecutive rows of @ref MTX_PIXELS values
+   * 
+   * Raw frames are read in bursts; filtered frames one at a time, as the 
+   * filter only applies to the current frame.
+   * 
+   * @param dst room for @p n frames
+   * @param n number of frames
+   * @param filtered if true, copy the frames after @ref apply_filter
+   * @return int the number of frames read, less than @p n on error or if no
+   * frame came within the timeout
+   * @see mightex_acquire_into
+   * @note This method is **not exposed** via SWIG.
+   */
+  int read_frames_into(uint16_t *dst, int n, bool filtered = false) {
+    return mightex_acquire_into(m, dst, NULL, n,
+                                filtered ? MTX_ACQUIRE_FILTERED
+                                         : MTX_ACQUIRE_RAW);
+  }
 #endif
 /**@}*/
 };
+
+/**
+ * @brief Class wrapping a frame accumulator
+ * 
+ * Sums raw frames natively, at camera rate, rather than in scripting 
+ * language loops over @ref Mightex1304::frame. In Python:
+ * 
+ * ```python
+ * acc = Accumulator(100)
+ * for i in range(100):
+ *   m.read_frame()
+ *   acc.add(m)
+ * mean = acc.mean()
+ * ```
+ */
+class Accumulator {
+private:
+  mightex_accumulator_t *acc;
+
+public:
+  /**
+   * @brief Construct a new Accumulator object
+   * 
+   * @param frames the number of frames N
+   * @param sliding if true, sums are over the last N frames, else over 
+   * blocks of N frames
+   */
+  Accumulator(unsigned int frames, bool sliding = false) {
+    acc = mightex_accumulator_new((uint16_t)frames,
+                                  sliding ? MTX_ACC_SLIDING : MTX_ACC_BLOCK);
+  }
+
+  /**
+   * @brief Destroy the Accumulator object
+   * 
+   */
+  ~Accumulator() { mightex_accumulator_free(acc); }
+
+#ifndef SWIG
+  // the sums are owned by one object only
+  Accumulator(const Accumulator &) = delete;
+  Accumulator &operator=(const Accumulator &) = delete;
+#endif
+
+  /**
+   * @brief Add the current raw frame of a camera
+   * 
+   * @param cam 
+   * @return int the number of frames in the sums
+   */
+  int add(Mightex1304 &cam) {
+    return mightex_accumulator_add_frame(acc, cam.handle());
+  }
+
+  /**
+   * @brief Discard all the frames summed so far
+   * 
+   */
+  void reset() { mightex_accumulator_reset(acc); }
+
+  /**
+   * @brief Number of frames in the sums
+   * 
+   * @return int 
+   */
+  int count() { return mightex_accumulator_count(acc); }
+
+  /**
+   * @brief Per-pixel sums
+   * 
+   * @return std::vector<unsigned int> 
+   */
+  std::vector<unsigned int> sum() {
+    const uint32_t *s = mightex_accumulator_sum(acc);
+    return std::vector<unsigned int>(s, s + MTX_PIXELS);
+  }
+
+  /**
+   * @brief Per-pixel mean
+   * 
+   * @return std::vector<double> 
+   */
+  std::vector<double> mean() {
+    std::vector<double> v(MTX_PIXELS);
+    mightex_accumulator_mean(acc, v.data());
+    return v;
+  }
+
+  /**
+   * @brief Per-pixel sample variance
+   * 
+   * @return std::vector<double> 
+   */
+  std::vector<double> variance() {
+    std::vector<double> v(MTX_PIXELS);
+    mightex_accumulator_variance(acc, v.data());
+    return v;
+  }
+};
+
+/**
+ * @brief Class reading the frames of a ring: those published by a camera in
+ * another process, or those recorded in a file
+ * 
+ * Consumers never make the publisher wait: one that falls behind by a whole
+ * ring skips to the newest frame. In Python:
+ * 
+ * ```python
+ * ring = FrameRing("/mightex1304")
+ * while ring.next(1000):
+ *   print(ring.index(), ring.timestamp(), max(ring.frame()))
+ * ```
+ */
+class FrameRing {
+private:
+  mightex_ring_t *r;
+  uint64_t _cursor = 0;
+  uint64_t _skipped = 0;
+  uint16_t _pixels[MTX_PIXELS] = {0};
+  uint16_t _meta[MTX_META_VALUES] = {0};
+
+public:
+  /**
+   * @brief Open a ring for reading, from the frames written from now on
+   * 
+   * @param name the shared memory object name, or the file path
+   * @param shared if false, @p name is a file written by a recorder
+   */
+  FrameRing(const std::string &name, bool shared = true) {
+    r = shared ? mightex_ring_open_shared(name.c_str())
+               : mightex_ring_open(name.c_str());
+    _cursor = r ? mightex_ring_count(r) : 0;
+  }
+
+  /**
+   * @brief Unmap the ring
+   * 
+   */
+  ~FrameRing() { mightex_ring_close(r); }
+
+#ifndef SWIG
+  // the mapping is owned by one object only
+  FrameRing(const FrameRing &) = delete;
+  FrameRing &operator=(const FrameRing &) = delete;
+#endif
+
+  /**
+   * @brief Whether the ring could be opened
+   * 
+   * @return bool 
+   */
+  bool is_open() { return r != nullptr; }
+
+  /**
+   * @brief Capacity of the ring, in frames
+   * 
+   * @return int 
+   */
+  int capacity() { return r ? mightex_ring_capacity(r) : 0; }
+
+  /**
+   * @brief Number of frames written to the ring so far
+   * 
+   * @return unsigned long long 
+   */
+  unsigned long long count() { return r ? mightex_ring_count(r) : 0; }
+
+  /**
+   * @brief Go to a frame, e.g. to `count() - capacity()` to read all the 
+   * frames the ring holds
+   * 
+   * @param index the frame number read by the next call to @ref next
+   */
+  void seek(unsigned long long index) { _cursor = index; }
+
+  /**
+   * @brief Read the next frame, waiting for it if needed
+   * 
+   * @param timeout_ms maximum wait, in milliseconds
+   * @return bool false on timeout
+   */
+  bool next(int timeout_ms = 1000) {
+    return next(_pixels, _meta, timeout_ms);
+  }
+
+  /**
+   * @brief Number of the last frame read
+   * 
+   * @return unsigned long long 
+   */
+  unsigned long long index() { return _cursor - 1; }
+
+  /**
+   * @brief Number of frames skipped so far, for falling behind
+   * 
+   * @return unsigned long long 
+   */
+  unsigned long long skipped() { return _skipped; }
+
+  /**
+   * @brief Raw values of the last frame read
+   * 
+   * @return std::vector<int> 
+   */
+  std::vector<int> frame() {
+    return std::vector<int>(_pixels, _pixels + MTX_PIXELS);
+  }
+
+  /**
+   * @brief Metadata of the last frame read, ordered as in 
+   * @ref mtx_meta_index_t
+   * 
+   * @return std::vector<int> 
+   */
+  std::vector<int> meta() {
+    return std::vector<int>(_meta, _meta + MTX_META_VALUES);
+  }
+
+  /**
+   * @brief Timestamp of the last frame read
+   * 
+   * @return unsigned int 
+   */
+  unsigned int timestamp() { return _meta[MTX_META_TIMESTAMP]; }
+
+  /**
+   * @brief Mean of the shielded pixels of the last frame read
+   * 
+   * @return unsigned int 
+   */
+  unsigned int dark_mean() { return _meta[MTX_META_DARK_MEAN]; }
+
+#ifndef SWIG
+  /**
+   * @brief Read the next frame into the caller's memory
+   * 
+   * @param pixels room for @ref MTX_PIXELS values, or NULL
+   * @param meta room for @ref MTX_META_VALUES values, or NULL
+   * @param timeout_ms maximum wait, in milliseconds
+   * @return bool false on timeout
+   * @note This method is **not exposed** via SWIG.
+   */
+  bool next(uint16_t *pixels, uint16_t *meta, int timeout_ms = 1000) {
+    uint64_t from = _cursor;
+    if (!r ||
+        mightex_ring_next(r, &_cursor, pixels, meta, timeout_ms) != MTX_OK)
+      return false;
+    _skipped += _cursor - from - 1;
+    return true;
+  }
+
+  /**
+   * @brief View of the raw values of the last frame read by @ref next()
+   * 
+   * @return FrameView valid until the next call
+   * @note This method is **not exposed** via SWIG.
+   */
+  FrameView frame_view() { return FrameView(_pixels, MTX_PIXELS); }
+
+  /**
+   * @brief The underlying ring, for the C functions not wrapped here
+   * 
+   * @return mightex_ring_t* 
+   * @note This method is **not exposed** via SWIG.
+   */
+  mightex_ring_t *handle() { return r; }
+#endif
+};
+
+//   ____        _   _                 
+//  |  _ \ _   _| |_| |__   ___  _ __  
+//  | |_) | | | | __| '_ \ / _ \| '_ \ 
+//  |  __/| |_| | |_| | | | (_) | | | |
+//  |_|    \__, |\__|_| |_|\___/|_| |_|
+//         |___/                       
+
+#if defined(SWIG) && defined(SWIGPYTHON)
+// Frames as uint16 arrays through the buffer protocol: numpy.asarray() and 
+// memoryview() view the driver buffers without copying
+%{
+// Exporter of the pixels of a held frame, which stays held as long as the
+// exporter or any array viewing it exists
+typedef struct {
+  PyObject_HEAD
+  mightex_frame_t *frame;
+  const uint16_t *data;
+} mtx_py_frame_t;
+
+static Py_ssize_t mtx_py_shape[1] = {MTX_PIXELS};
+static Py_ssize_t mtx_py_strides[1] = {sizeof(uint16_t)};
+static PyObject *mtx_py_frame_type = NULL;
+
+static void mtx_py_frame_dealloc(PyObject *self) {
+  PyTypeObject *tp = Py_TYPE(self);
+  mightex_frame_release(((mtx_py_frame_t *)self)->frame);
+  tp->tp_free(self);
+  Py_DECREF(tp);
+}
+
+static int mtx_py_frame_getbuffer(PyObject *self, Py_buffer *view, int flags) {
+  mtx_py_frame_t *f = (mtx_py_frame_t *)self;
+  if (PyBuffer_FillInfo(view, self, (void *)f->data,
+                        MTX_PIXELS * sizeof(uint16_t), 1, flags) != 0)
+    return -1;
+  view->itemsize = sizeof(uint16_t);
+  if (flags & PyBUF_FORMAT)
+    view->format = (char *)"H";
+  if (flags & PyBUF_ND)
+    view->shape = mtx_py_shape;
+  if ((flags & PyBUF_STRIDES) == PyBUF_STRIDES)
+    view->strides = mtx_py_strides;
+  return 0;
+}
+
+static PyType_Slot mtx_py_frame_slots[] = {
+    {Py_tp_dealloc, (void *)mtx_py_frame_dealloc},
+    {Py_bf_getbuffer, (void *)mtx_py_frame_getbuffer},
+    {Py_tp_doc, (void *)"Read-only uint16 view of a held frame"},
+    {0, NULL}};
+
+static PyType_Spec mtx_py_frame_spec = {
+    "mightex.FrameBuffer", sizeof(mtx_py_frame_t), 0, Py_TPFLAGS_DEFAULT,
+    mtx_py_frame_slots};
+
+// Wrap a reference to a frame, taking it over
+static PyObject *mtx_py_frame_new(mightex_frame_t *frame,
+                                  const uint16_t *data) {
+  mtx_py_frame_t *f;
+  if (!frame) {
+    PyErr_SetString(PyExc_RuntimeError, "No frame read");
+    return NULL;
+  }
+  if (!mtx_py_frame_type)
+    mtx_py_frame_type = PyType_FromSpec(&mtx_py_frame_spec);
+  if (!mtx_py_frame_type ||
+      !(f = PyObject_New(mtx_py_frame_t, (PyTypeObject *)mtx_py_frame_type))) {
+    mightex_frame_release(frame);
+    return NULL;
+  }
+  f->frame = frame;
+  f->data = data;
+  return (PyObject *)f;
+}
+%}
+
+%extend Mightex1304 {
+  /**
+   * @brief The last frame, as a buffer of uint16: the filtered values once it
+   * went through the filter or a pipeline, the raw ones until then
+   * 
+   * The frame is held, so the buffer stays valid after the next read. The 
+   * filtered values are not copied: filtering this frame again, e.g. with 
+   * `process()` or `apply_filter()`, rewrites them under the buffer.
+   */
+  PyObject *frame_buffer() {
+    mightex_frame_t *f = mightex_frame_hold($self->handle(), 0);
+    const uint16_t *data = NULL;
+    if (f && !(data = mightex_frame_filtered(f)))
+      data = mightex_frame_pixels(f);
+    return mtx_py_frame_new(f, data);
+  }
+
+  /**
+   * @brief The raw values of the last frame, as a buffer of uint16
+   */
+  PyObject *raw_frame_buffer() {
+    mightex_frame_t *f = mightex_frame_hold($self->handle(), 0);
+    return mtx_py_frame_new(f, f ? mightex_frame_pixels(f) : NULL);
+  }
+
+  /**
+   * @brief Read frames into a writable, C-contiguous uint16 buffer of 
+   * (N, MTX_PIXELS) values, e.g. a NumPy array, without holding the GIL
+   * 
+   * @return the number of frames read
+   */
+  PyObject *read_frames_into(PyObject *dst, bool filtered = false) {
+    Py_buffer b;
+    int n;
+    size_t row = MTX_PIXELS * sizeof(uint16_t);
+    if (PyObject_GetBuffer(dst, &b, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS |
+                                        PyBUF_FORMAT) != 0)
+      return NULL;
+    if (b.itemsize != sizeof(uint16_t) || !b.format ||
+        b.format[strlen(b.format) - 1] != 'H' || b.len % row != 0) {
+      PyBuffer_Release(&b);
+      PyErr_SetString(PyExc_ValueError,
+                      "Expected a uint16 array of (N, pixel_count()) values");
+      return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    n = $self->read_frames_into((uint16_t *)b.buf, (int)(b.len / row),
+                                filtered);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&b);
+    return PyLong_FromLong(n);
+  }
+
+  %pythoncode %{
+    def frame_array(self):
+        """The last frame, filtered once processed, viewed as a uint16 array"""
+        import numpy
+        return numpy.asarray(self.frame_buffer())
+
+    def raw_frame_array(self):
+        """The raw values of the last frame, viewed as a uint16 array"""
+        import numpy
+        return numpy.asarray(self.raw_frame_buffer())
+
+    def read_frames_array(self, n, filtered=False):
+        """Read n frames into a new (n, pixel_count()) uint16 array"""
+        import numpy
+        a = numpy.empty((n, self.pixel_count()), dtype=numpy.uint16)
+        return a[:self.read_frames_into(a, filtered)]
+  %}
+}
+#endif
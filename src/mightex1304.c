@@ -6,14 +6,48 @@
 #include <arpa/inet.h>
 #endif
 #include <assert.h>
+#include <errno.h>
 #include <libusb-1.0/libusb.h>
+#include <math.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #ifdef _WIN32
 #include <stdint.h>
+#else
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#define MTX_THREADS 1
+#define MTX_RINGS 1
 #endif // _WIN32
 
+// SIMD pixel kernels: SSE2 is part of x86-64, AVX2 is detected at runtime,
+// NEON is used when the compiler targets it (always on arm64)
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define MTX_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(_MSC_VER)
+#define MTX_AVX2 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MTX_TARGET_AVX2
+#else
+#define MTX_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MTX_NEON 1
+#include <arm_neon.h>
+#endif
+
 #define USB_IDVENDOR 0x04B4
 #define USB_IDPRODUCT 0x0328
 #define MTX_TIMEOUT 2000
@@ -32,6 +66,61 @@
 
 #define STRING_LENGTH 14
 
+// mightex_wait_frame() sleeps until MTX_WAIT_MARGIN_US before the frame is
+// expected, then polls every MTX_WAIT_POLL_US, backing off up to
+// MTX_WAIT_MAX_POLL_US when the frame is late (e.g. waiting for a trigger)
+#define MTX_WAIT_MARGIN_US 500.0
+#define MTX_WAIT_POLL_US 200.0
+#define MTX_WAIT_MAX_POLL_US 10000.0
+
+// Simulated device: one USB transaction costs a high-speed microframe, a frame
+// payload moves at roughly 40 MB/s, and the sensor cannot run faster than
+// MTX_SIM_MIN_PERIOD_US per line
+#define MTX_SIM_LATENCY_US 125.0
+#define MTX_SIM_XFER_US 190.0
+#define MTX_SIM_MIN_PERIOD_US 250.0
+#define MTX_SIM_DARK 1200
+#define MTX_SIM_NO_TRIGGER_US 1.0E12
+#define MTX_SIM_SERIAL "SIM-0000001"
+
+// Polling interval of a consumer blocked in mightex_pop_frame()
+#define MTX_POP_POLL_US 100.0
+
+// Layout of a buffer in a caller's region: its frames, then the filtered view,
+// each starting on a MTX_BUFFER_ALIGN boundary
+#define MTX_BUFFER_ROUND(x)                                                    \
+  (((x) + MTX_BUFFER_ALIGN - 1) & ~(size_t)(MTX_BUFFER_ALIGN - 1))
+#define MTX_BUFFER_STRIDE(frames)                                              \
+  (MTX_BUFFER_ROUND((frames) * sizeof(ccd_frames_t)) +                         \
+   MTX_BUFFER_ROUND(MTX_PIXELS * sizeof(uint16_t)))
+
+// With auto-reconnect, a lost camera is looked for at least this often, even
+// without hotplug notifications
+#define MTX_RECONNECT_INTERVAL_US 500000.0
+
+// Failed stream transfers in a row (stall, overflow, error) retried on the
+// same slot before the camera is treated as lost
+#define MTX_STREAM_RETRIES 3
+
+// Cameras that can share the event thread
+#define MTX_MAX_SHARED 32
+
+#ifdef MTX_THREADS
+#define SIM_LOCK(s) pthread_mutex_lock(&(s)->lock)
+#define SIM_UNLOCK(s) pthread_mutex_unlock(&(s)->lock)
+#define SHARED_LOCK() pthread_mutex_lock(&mtx_shared.lock)
+#define SHARED_UNLOCK() pthread_mutex_unlock(&mtx_shared.lock)
+#define CAM_LOCK(m) pthread_mutex_lock(&(m)->lock)
+#define CAM_UNLOCK(m) pthread_mutex_unlock(&(m)->lock)
+#else
+#define SIM_LOCK(s)
+#define SIM_UNLOCK(s)
+#define CAM_LOCK(m)
+#define CAM_UNLOCK(m)
+#define SHARED_LOCK()
+#define SHARED_UNLOCK()
+#endif
+
 typedef union {
 #ifdef _WIN32
   struct di {
@@ -82,6 +171,192 @@ typedef union {
   BYTE buf[sizeof(struct frame)];
 } ccd_frames_t;
 
+// Pixels of a frame: the image data sits at an even offset in the packed
+// frame, and frame buffers are aligned, so the pointer is aligned too
+static uint16_t *ccd_pixels(ccd_frames_t *f) {
+  return (uint16_t *)(f->buf + offsetof(struct frame, image_data));
+}
+
+// Frame buffer of the pool: the frames of one read, filled in place by the
+// transfer and shared by reference with the consumers. The pool holds one
+// reference to each buffer, so that a buffer is free when refs is 1 and is
+// freed by whoever drops the last reference, even after mightex_close().
+struct mightex_frame {
+  struct mtx_buf *buf;
+  int index;
+};
+
+typedef struct mtx_buf {
+#ifdef MTX_THREADS
+  atomic_int refs;
+#else
+  int refs;
+#endif
+  struct mtx_buf *next; // in the pool
+  int capacity;         // frames
+  int count;            // frames read
+  int filtered;         // view holds the filtered frame 0
+  int external;         // frames and view in the caller's region
+  uint16_t *view;       // allocated when first needed by a filter
+  unsigned long gaps;   // reconnections before it was read
+  unsigned int dropped; // triggered frames the queue dropped just before it
+  uint16_t dark_means[MTX_MAX_FRAMES];
+  unsigned int missed[MTX_MAX_FRAMES];
+  struct mightex_frame handles[MTX_MAX_FRAMES];
+  ccd_frames_t *frames;
+} mtx_buf_t;
+
+// One element of the streaming ring: a command transfer asking for a frame and
+// the bulk transfer that receives it
+typedef struct {
+  struct mightex *m;
+  struct libusb_transfer *cmd;
+  struct libusb_transfer *xfer;
+  BYTE cmd_buf[3];
+  int cmd_busy, xfer_busy, resubmit;
+  int errors;          // failed transfers in a row
+  struct mtx_buf *buf; // receives the frame in place
+} mtx_slot_t;
+
+// State of the simulated camera
+typedef struct {
+  double t_start;           // time of the first line (us)
+  double period;            // line period (us)
+  double last_done;         // completion time of the last streamed frame (us)
+  unsigned long produced;   // lines exposed so far
+  unsigned long consumed;   // lines handed over to the host
+  int pending;              // frames requested with MTX_CMD_GETBUFFEREDDATA
+  BYTE reply[64];
+  int reply_len;
+  BYTE mode;
+  BYTE gpio[4];
+  float exptime;
+  double trigger_period;    // period of the simulated trigger source (us)
+  unsigned int trigger_step; // triggers per line in trigger mode, else 0
+  unsigned long trigger_base; // trigger events before t_start
+  double unplugged_until;   // time the device comes back on the bus (us)
+  uint32_t seed;
+  int scene;                // mtx_sim_scene_t
+  uint16_t profile[MTX_PIXELS];
+  uint8_t dsnu[MTX_PIXELS]; // fixed pattern of the dark signal
+  float prnu[MTX_PIXELS];   // fixed pattern of the pixel response
+#ifdef MTX_THREADS
+  pthread_mutex_t lock;
+#endif
+} mtx_sim_t;
+
+// Single-producer/single-consumer frame queue filled by the acquisition
+// thread: head is only written by the producer, tail by the consumer
+typedef struct {
+  mtx_buf_t **slots;
+  unsigned long mask;
+#ifdef MTX_THREADS
+  atomic_ulong head;
+  atomic_ulong tail;
+  atomic_ulong dropped;
+  unsigned int dropped_triggered; // since the last frame queued
+  atomic_int running;
+  pthread_t thread;
+#endif
+} mtx_queue_t;
+
+// Frame ring: a file or a POSIX shared memory object mapped in memory, with a
+// header and a ring of records, each holding a raw frame. A record is written
+// under a sequence lock: begin and end hold the index + 1 of the frame in it,
+// begin being set before the payload is copied and end after, so that a 
+// record is valid when both match the index asked for, and a reader copying
+// it can tell whether the writer came round meanwhile. committed is the 
+// number of frames written so far.
+#define MTX_RING_MAGIC 0x4D545852 // "MTXR"
+#define MTX_RING_VERSION 1
+
+#ifdef MTX_RINGS
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t pixels;
+  uint32_t capacity;    // records
+  uint32_t record_size; // bytes
+  BYTE serial_no[STRING_LENGTH];
+  BYTE _reserved1[2];
+  atomic_ullong committed;
+  BYTE _reserved2[24];
+} mtx_ring_header_t;
+
+typedef struct {
+  atomic_ullong begin;
+  atomic_ullong end;
+  uint16_t dark_mean;
+  uint16_t missed;
+  BYTE _reserved[44];
+  ccd_frames_t frame;
+} mtx_record_t;
+
+struct mightex_ring {
+  int fd;                 // kept open by the writer, for its lock
+  int writer;
+  size_t size;            // of the mapping
+  uint32_t capacity;
+  mtx_ring_header_t *header;
+  mtx_record_t *records;
+  uint64_t next;          // index of the next frame to be written
+  int trigger_seen;       // the writer has seen a triggered frame
+  uint16_t last_trigger;  // and this was its trigger counter
+};
+#endif
+
+// Record of the on-disk cache used by MTX_OPEN_CACHE: what mightex_new()
+// would otherwise query, keyed by serial number and USB port
+#define MTX_CACHE_MAGIC 0x4D545843 // "MTXC"
+#define MTX_CACHE_FILE "mightex1304.cache"
+#define MTX_MAX_PORTS 7
+
+typedef struct {
+  uint32_t magic;
+  uint8_t bus;
+  uint8_t n_ports;
+  uint8_t ports[MTX_MAX_PORTS];
+  unsigned char manufacturer[64];
+  unsigned char product[64];
+  char version[12];
+  device_info_t device_info;
+  device_version_t device_version;
+} mtx_cache_entry_t;
+
+// Calibration tables: per-pixel dark signal and gain (in fixed point, with
+// MTX_GAIN_BITS fractional bits) for a given exposure time, and the header of
+// the file they are saved to
+#define MTX_MAX_CALIB 16
+#define MTX_CALIB_MAGIC 0x4D54584B // "MTXK"
+#define MTX_GAIN_BITS 12
+#define MTX_GAIN_ONE (1 << MTX_GAIN_BITS)
+
+typedef struct {
+  uint16_t exptime; // in camera units (0.1 ms)
+  uint16_t flat;    // 1 if gain holds a flat-field correction
+  uint16_t dark[MTX_PIXELS];
+  uint16_t gain[MTX_PIXELS];
+} mtx_calib_t;
+
+typedef struct {
+  uint32_t magic;
+  uint16_t pixels;
+  uint16_t count;
+  BYTE serial_no[STRING_LENGTH];
+} mtx_calib_header_t;
+
+// Frame accumulator: per-pixel sums of the frames and of their squares; in
+// sliding mode, also the ring of the frames in the window
+struct mightex_accumulator {
+  mtx_acc_mode_t mode;
+  uint16_t frames;
+  uint16_t count;
+  uint16_t next; // ring slot of the next frame
+  uint32_t sum[MTX_PIXELS];
+  uint64_t sq[MTX_PIXELS];
+  uint16_t *ring;
+};
+
 typedef struct mightex {
   libusb_device *dev;
   libusb_device_handle *handle;
@@ -92,309 +367,3864 @@ typedef struct mightex {
   unsigned int timeout;
   device_info_t device_info;
   device_version_t device_version;
-  ccd_frames_t frames[4];
-  uint16_t data[MTX_PIXELS];
+  mtx_buf_t *pool;
+  mtx_buf_t *cur;     // the frames of the last read
+  int pool_frames;    // frames per buffer of the caller's region, else 0
+  int stale;          // view not copied from the current frame yet
   uint16_t dark_mean;
+  int frame_count;
+  float exptime;
+  double next_due;
   char version[12];
   char sw_version[64];
   mightex_filter_t *filter;
   mightex_estimator_t *estimator;
+  mightex_multi_estimator_t *multi_estimator;
+  mightex_roi_t roi[MTX_MAX_ROI];
+  int n_roi;          // 0 for the full frame
+  int tracking;       // window 0 follows the estimate
+  int searching;      // window 0 lost, searching the full frame
+  unsigned long searches;
+  mtx_sim_t *sim;
+  mtx_slot_t *stream;
+  int stream_depth;
+  int stream_active;
+  unsigned long stream_count;
+  mightex_frame_cb_t *stream_cb;
+  void *stream_ud;
+  mtx_queue_t *queue;
+  mightex_ring_t *recorder;
+  mightex_ring_t *publisher;
+  int shared;
+  mtx_mode_t mode;
+  int trigger_seen;
+  uint16_t last_trigger;
+  unsigned long dropped_triggers;
+  mightex_auto_exposure_t ae;
+  int ae_enabled;
+  float ae_pending;   // exposure time to be set, or 0
+  double ae_last;     // time of the last change (us)
+  mtx_calib_t *calib; // MTX_MAX_CALIB tables, allocated on first use
+  int n_calib;
+  int auto_reconnect; // 2 if also notified by hotplug events
+#ifdef MTX_THREADS
+  atomic_int lost;    // also set by hotplug callbacks
+  atomic_int arrived;
+  atomic_ulong gaps;  // reconnections, maybe on the acquisition thread
+  // held over each exchange with the camera, and over reconnection, which
+  // the acquisition thread may do under other threads sending commands
+  pthread_mutex_t lock;
+#else
+  int lost;
+  int arrived;
+  unsigned long gaps;
+#endif
+  double last_attempt;
+  unsigned long trigger_gaps; // reconnections before the last frame stored
+  libusb_hotplug_callback_handle hotplug;
 } mightex_t;
 
+// libusb context shared by the cameras opened with mightex_open_serial() and
+// mightex_open_all(), with the thread handling their events
+static struct {
+  libusb_context *ctx;
+  int refs;    // cameras using the context
+  int streams; // cameras whose acquisition thread runs on the event thread
+  mightex_t *cams[MTX_MAX_SHARED]; // and those cameras
+#ifdef MTX_THREADS
+  pthread_mutex_t lock;
+  pthread_mutex_t cams_lock;
+  pthread_t thread;
+  atomic_int running;
+#endif
+} mtx_shared = {
+    NULL, 0, 0, {NULL},
+#ifdef MTX_THREADS
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER,
+#endif
+};
+
 //   ____  _        _   _
 //  / ___|| |_ __ _| |_(_) ___ ___
 //  \___ \| __/ _` | __| |/ __/ __|
 //   ___) | || (_| | |_| | (__\__ \
 //  |____/ \__\__,_|\__|_|\___|___/
 
-static void filter_dark(mightex_t *m, uint16_t *const data, uint16_t len,
-                        void *ud) {
-  register uint16_t i = 0;
-  for (i = 0; i < MTX_PIXELS; i++) {
-    data[i] = data[i] < m->dark_mean ? 0 : data[i] - m->dark_mean;
+// Pixel kernels
+//
+// Each kernel has a scalar version (also used for the tail of the vector 
+// ones) and, where available, SSE2, AVX2 and NEON versions. The dispatcher
+// picks the best one supported by the running CPU.
+
+#ifdef MTX_AVX2
+static int cpu_has_avx2(void) {
+#ifdef _MSC_VER
+  static int has = -1;
+  int r[4];
+  if (has < 0) {
+    __cpuid(r, 1);
+    // the OS must save the AVX registers too
+    has = (r[2] & (1 << 27)) && (r[2] & (1 << 28)) &&
+          (_xgetbv(0) & 0x6) == 0x6;
+    if (has) {
+      __cpuidex(r, 7, 0);
+      has = (r[1] & (1 << 5)) != 0;
+    }
   }
+  return has;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+// Saturating subtraction: data[i] = max(data[i] - v, 0)
+static void sub_sat_scalar(uint16_t *data, int len, uint16_t v) {
+  int i;
+  for (i = 0; i < len; i++)
+    data[i] = data[i] < v ? 0 : data[i] - v;
 }
 
-static double estimator_center(mightex_t *m, uint16_t *const data, uint16_t len,
-                               void *ud) {
-  register uint16_t i = 0;
-  double num = 0, den = 0;
-  uint16_t thr = m->dark_mean * 3;
-  for (i = 0; i < MTX_PIXELS; i++) {
+// Centroid sums over the pixels not below thr: num += i * data[i] and
+// den += data[i], for i from i0 to len - 1. With 16-bit lengths, products and
+// den fit in 32 bits, while num needs 64.
+static void centroid_scalar(const uint16_t *data, int i0, int len,
+                            uint16_t thr, uint64_t *num, uint64_t *den) {
+  int i;
+  uint64_t n = 0;
+  uint32_t d = 0;
+  for (i = i0; i < len; i++) {
     if (data[i] < thr)
       continue;
-    num += (i * data[i]);
-    den += data[i];
+    n += (uint32_t)i * data[i];
+    d += data[i];
   }
-  return num / den;
+  *num += n;
+  *den += d;
 }
 
-static mtx_result_t mightex_send(mightex_t *m, BYTE *const buf, int len) {
-  int rc;
-  rc = libusb_bulk_transfer(m->handle, MTX_EP_CMD, buf, len, NULL, m->timeout);
-  if (rc != LIBUSB_SUCCESS) {
-    fprintf(stderr, "Error on send: %s\n", libusb_error_name(rc));
-    return MTX_FAIL;
+// Both of the above in a single pass, from src to dst
+static void dark_centroid_scalar(const uint16_t *src, uint16_t *dst, int i0,
+                                 int len, uint16_t dark, uint16_t thr,
+                                 uint64_t *num, uint64_t *den) {
+  int i;
+  uint16_t v;
+  uint64_t n = 0;
+  uint32_t d = 0;
+  for (i = i0; i < len; i++) {
+    v = src[i] < dark ? 0 : src[i] - dark;
+    dst[i] = v;
+    if (v < thr)
+      continue;
+    n += (uint32_t)i * v;
+    d += v;
   }
-  return MTX_OK;
+  *num += n;
+  *den += d;
 }
 
-static mtx_result_t mightex_receive(mightex_t *m, BYTE *const buf, int len) {
-  int rc;
-  rc =
-      libusb_bulk_transfer(m->handle, MTX_EP_REPLY, buf, len, NULL, m->timeout);
-  if (rc != LIBUSB_SUCCESS) {
-    fprintf(stderr, "Error on receive: %s\n", libusb_error_name(rc));
-    return MTX_FAIL;
+#ifdef MTX_SSE2
+static void sub_sat_sse2(uint16_t *data, int len, uint16_t v) {
+  int i;
+  __m128i vv = _mm_set1_epi16((short)v);
+  for (i = 0; i + 8 <= len; i += 8) {
+    __m128i x = _mm_loadu_si128((__m128i *)(data + i));
+    _mm_storeu_si128((__m128i *)(data + i), _mm_subs_epu16(x, vv));
   }
-  return (mtx_result_t)buf[0];
+  sub_sat_scalar(data + i, len - i, v);
 }
 
-static mtx_result_t mightex_get_version(mightex_t *m) {
-  int rc;
-  device_version_t *dv = &m->device_version;
-  // request
-  memset(dv, 0, sizeof(device_info_t));
-  dv->buf[0] = MTX_CMD_FIRMWARE;
-  dv->buf[1] = 0x01;
-  dv->buf[2] = 0x02;
-  rc = mightex_send(m, dv->buf, 3);
-  if (rc != MTX_OK)
-    return MTX_FAIL;
-  // reply
-  memset(dv, 0, sizeof(device_info_t));
-  rc = mightex_receive(m, dv->buf, sizeof(dv->version));
-  snprintf(m->version, sizeof(m->version), "%d.%d.%d", dv->version.major,
-           dv->version.minor, dv->version.rev);
-  return rc;
+// Add the centroid terms of the 8 pixels x, at indices idx, to the 64-bit
+// lanes of vn and the 32-bit lanes of vd
+static inline void centroid_acc_sse2(__m128i x, __m128i idx, __m128i tv,
+                                     __m128i *vn, __m128i *vd) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i lo, hi, p0, p1;
+  // x >= thr exactly when thr - x saturates to 0
+  x = _mm_and_si128(x, _mm_cmpeq_epi16(_mm_subs_epu16(tv, x), zero));
+  lo = _mm_mullo_epi16(x, idx);
+  hi = _mm_mulhi_epu16(x, idx);
+  p0 = _mm_unpacklo_epi16(lo, hi);
+  p1 = _mm_unpackhi_epi16(lo, hi);
+  *vn = _mm_add_epi64(*vn, _mm_unpacklo_epi32(p0, zero));
+  *vn = _mm_add_epi64(*vn, _mm_unpackhi_epi32(p0, zero));
+  *vn = _mm_add_epi64(*vn, _mm_unpacklo_epi32(p1, zero));
+  *vn = _mm_add_epi64(*vn, _mm_unpackhi_epi32(p1, zero));
+  *vd = _mm_add_epi32(*vd, _mm_add_epi32(_mm_unpacklo_epi16(x, zero),
+                                         _mm_unpackhi_epi16(x, zero)));
 }
 
-static mtx_result_t mightex_get_info(mightex_t *m) {
-  int rc;
-  device_info_t *di = &m->device_info;
-  // request
-  memset(di, 0, sizeof(device_info_t));
-  di->buf[0] = MTX_CMD_INFO;
-  di->buf[1] = 0x01;
-  di->buf[2] = 0x00;
-  rc = mightex_send(m, di->buf, 3);
-  if (rc != MTX_OK)
-    return MTX_FAIL;
-  // reply
-  memset(di, 0, sizeof(device_info_t));
-  rc = mightex_receive(m, di->buf, sizeof(device_info_t));
-  return rc;
+static inline void centroid_sum_sse2(__m128i vn, __m128i vd, uint64_t *num,
+                                     uint64_t *den) {
+  uint64_t out[2];
+  _mm_storeu_si128((__m128i *)out, vn);
+  *num = out[0] + out[1];
+  vd = _mm_add_epi32(vd, _mm_unpackhi_epi64(vd, vd));
+  vd = _mm_add_epi32(vd, _mm_srli_si128(vd, 4));
+  *den = (uint32_t)_mm_cvtsi128_si32(vd);
 }
 
-static mtx_result_t mightex_prepare_buffered_data(mightex_t *m, BYTE n) {
-  BYTE buf[3];
-  buf[0] = MTX_CMD_GETBUFFEREDDATA;
-  buf[1] = 0x01;
-  buf[2] = n;
-  return mightex_send(m, buf, sizeof(buf));
+static void centroid_sse2(const uint16_t *data, int len, uint16_t thr,
+                          uint64_t *num, uint64_t *den) {
+  int i;
+  const __m128i step = _mm_set1_epi16(8);
+  __m128i tv = _mm_set1_epi16((short)thr);
+  __m128i idx = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+  __m128i vn = _mm_setzero_si128(), vd = _mm_setzero_si128();
+  for (i = 0; i + 8 <= len; i += 8) {
+    centroid_acc_sse2(_mm_loadu_si128((const __m128i *)(data + i)), idx, tv,
+                      &vn, &vd);
+    idx = _mm_add_epi16(idx, step);
+  }
+  centroid_sum_sse2(vn, vd, num, den);
+  centroid_scalar(data, i, len, thr, num, den);
 }
 
-//   __  __      _   _               _
-//  |  \/  | ___| |_| |__   ___   __| |___
-//  | |\/| |/ _ \ __| '_ \ / _ \ / _` / __|
-//  | |  | |  __/ |_| | | | (_) | (_| \__ \
-//  |_|  |_|\___|\__|_| |_|\___/ \__,_|___/
+static void dark_centroid_sse2(const uint16_t *src, uint16_t *dst, int len,
+                               uint16_t dark, uint16_t thr, uint64_t *num,
+                               uint64_t *den) {
+  int i;
+  const __m128i step = _mm_set1_epi16(8);
+  __m128i dv = _mm_set1_epi16((short)dark);
+  __m128i tv = _mm_set1_epi16((short)thr);
+  __m128i idx = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+  __m128i vn = _mm_setzero_si128(), vd = _mm_setzero_si128();
+  for (i = 0; i + 8 <= len; i += 8) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+    x = _mm_subs_epu16(x, dv);
+    _mm_storeu_si128((__m128i *)(dst + i), x);
+    centroid_acc_sse2(x, idx, tv, &vn, &vd);
+    idx = _mm_add_epi16(idx, step);
+  }
+  centroid_sum_sse2(vn, vd, num, den);
+  dark_centroid_scalar(src, dst, i, len, dark, thr, num, den);
+}
+#endif
 
-mightex_t *mightex_new() {
-  mightex_t *m = malloc(sizeof(mightex_t));
-  int rc;
-  ssize_t cnt, i = 0;
-  libusb_device **devs;
+#ifdef MTX_AVX2
+MTX_TARGET_AVX2
+static void sub_sat_avx2(uint16_t *data, int len, uint16_t v) {
+  int i;
+  __m256i vv = _mm256_set1_epi16((short)v);
+  for (i = 0; i + 16 <= len; i += 16) {
+    __m256i x = _mm256_loadu_si256((__m256i *)(data + i));
+    _mm256_storeu_si256((__m256i *)(data + i), _mm256_subs_epu16(x, vv));
+  }
+  sub_sat_scalar(data + i, len - i, v);
+}
 
-  m->timeout = MTX_TIMEOUT;
-  m->dark_mean = 0;
-  m->desc = malloc(sizeof(m->desc));
-  m->filter = filter_dark;
-  m->estimator = estimator_center;
-  snprintf(m->sw_version, sizeof(m->sw_version), "%s %s %s", GIT_COMMIT_HASH,
-           CMAKE_PLATFORM, CMAKE_BUILD_TYPE);
+MTX_TARGET_AVX2
+static inline void centroid_acc_avx2(__m256i x, __m256i idx, __m256i tv,
+                                     __m256i *vn, __m256i *vd) {
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i lo, hi, p0, p1;
+  x = _mm256_and_si256(x, _mm256_cmpeq_epi16(_mm256_max_epu16(x, tv), x));
+  lo = _mm256_mullo_epi16(x, idx);
+  hi = _mm256_mulhi_epu16(x, idx);
+  p0 = _mm256_unpacklo_epi16(lo, hi);
+  p1 = _mm256_unpackhi_epi16(lo, hi);
+  *vn = _mm256_add_epi64(*vn, _mm256_unpacklo_epi32(p0, zero));
+  *vn = _mm256_add_epi64(*vn, _mm256_unpackhi_epi32(p0, zero));
+  *vn = _mm256_add_epi64(*vn, _mm256_unpacklo_epi32(p1, zero));
+  *vn = _mm256_add_epi64(*vn, _mm256_unpackhi_epi32(p1, zero));
+  *vd = _mm256_add_epi32(*vd, _mm256_add_epi32(_mm256_unpacklo_epi16(x, zero),
+                                               _mm256_unpackhi_epi16(x, zero)));
+}
 
-  rc = libusb_init(&m->ctx);
-  if (rc < 0)
-    return NULL;
+MTX_TARGET_AVX2
+static inline void centroid_sum_avx2(__m256i vn, __m256i vd, uint64_t *num,
+                                     uint64_t *den) {
+  uint64_t out[4];
+  uint32_t d[8];
+  _mm256_storeu_si256((__m256i *)out, vn);
+  _mm256_storeu_si256((__m256i *)d, vd);
+  *num = out[0] + out[1] + out[2] + out[3];
+  *den = (uint64_t)d[0] + d[1] + d[2] + d[3] + d[4] + d[5] + d[6] + d[7];
+}
 
-  rc =
-      libusb_set_option(m->ctx, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_NONE);
-  if (rc != LIBUSB_SUCCESS)
-    fprintf(stderr, "> Could not set log level (%s).\n", libusb_error_name(rc));
+#define MTX_AVX2_INDICES                                                       \
+  _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15)
 
-  cnt = libusb_get_device_list(m->ctx, &devs);
-  if (cnt < 0) {
-    fprintf(stderr, "> No devices available.\n");
-    libusb_exit(m->ctx);
-    return NULL;
+MTX_TARGET_AVX2
+static void centroid_avx2(const uint16_t *data, int len, uint16_t thr,
+                          uint64_t *num, uint64_t *den) {
+  int i;
+  const __m256i step = _mm256_set1_epi16(16);
+  __m256i tv = _mm256_set1_epi16((short)thr);
+  __m256i idx = MTX_AVX2_INDICES;
+  __m256i vn = _mm256_setzero_si256(), vd = _mm256_setzero_si256();
+  for (i = 0; i + 16 <= len; i += 16) {
+    centroid_acc_avx2(_mm256_loadu_si256((const __m256i *)(data + i)), idx, tv,
+                      &vn, &vd);
+    idx = _mm256_add_epi16(idx, step);
   }
+  centroid_sum_avx2(vn, vd, num, den);
+  centroid_scalar(data, i, len, thr, num, den);
+}
 
-  while ((m->dev = devs[i++]) != NULL) {
-    rc = libusb_get_device_descriptor(m->dev, m->desc);
-    if (rc < 0) {
-      fprintf(stderr, ">>> FATAL: Failed to get device descriptor (%s).",
-              libusb_error_name(rc));
-      libusb_exit(m->ctx);
-      continue;
-    }
-    if (m->desc->idVendor == USB_IDVENDOR &&
-        m->desc->idProduct == USB_IDPRODUCT) {
-      device_info_t b;
-      memset(&b, 0, sizeof(b));
-      rc = libusb_open(m->dev, &m->handle);
-      if (rc != LIBUSB_SUCCESS) {
-        fprintf(stderr, ">>> FATAL: Could not open device (%s)\n",
-                libusb_error_name(rc));
-#ifdef _WIN32
-        fprintf(
-            stderr,
-            "    Perhaps WinUSB driver has not been installed and selected?\n");
+MTX_TARGET_AVX2
+static void dark_centroid_avx2(const uint16_t *src, uint16_t *dst, int len,
+                               uint16_t dark, uint16_t thr, uint64_t *num,
+                               uint64_t *den) {
+  int i;
+  const __m256i step = _mm256_set1_epi16(16);
+  __m256i dv = _mm256_set1_epi16((short)dark);
+  __m256i tv = _mm256_set1_epi16((short)thr);
+  __m256i idx = MTX_AVX2_INDICES;
+  __m256i vn = _mm256_setzero_si256(), vd = _mm256_setzero_si256();
+  for (i = 0; i + 16 <= len; i += 16) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+    x = _mm256_subs_epu16(x, dv);
+    _mm256_storeu_si256((__m256i *)(dst + i), x);
+    centroid_acc_avx2(x, idx, tv, &vn, &vd);
+    idx = _mm256_add_epi16(idx, step);
+  }
+  centroid_sum_avx2(vn, vd, num, den);
+  dark_centroid_scalar(src, dst, i, len, dark, thr, num, den);
+}
 #endif
-        libusb_exit(m->ctx);
-        return NULL;
-      }
 
-      rc = libusb_reset_device(m->handle);
-      if (rc != LIBUSB_SUCCESS)
-        fprintf(stderr, ">> Could not reset device (%s)\n",
-                libusb_error_name(rc));
-
-      rc = libusb_set_auto_detach_kernel_driver(m->handle, 1);
-      if (rc != LIBUSB_ERROR_NOT_SUPPORTED)
-        fprintf(stderr, ">> Could not set auto-detach (%s)\n",
-                libusb_error_name(rc));
-
-      rc = libusb_claim_interface(m->handle, 0);
-      if (rc != LIBUSB_SUCCESS) {
-        fprintf(stderr, ">>> FATAL: Could not claim device interface (%s)\n",
-                libusb_error_name(rc));
-        libusb_close(m->handle);
-        libusb_exit(m->ctx);
-        return NULL;
-      }
+#ifdef MTX_NEON
+static void sub_sat_neon(uint16_t *data, int len, uint16_t v) {
+  int i;
+  uint16x8_t vv = vdupq_n_u16(v);
+  for (i = 0; i + 8 <= len; i += 8)
+    vst1q_u16(data + i, vqsubq_u16(vld1q_u16(data + i), vv));
+  sub_sat_scalar(data + i, len - i, v);
+}
 
-      rc = libusb_get_string_descriptor_ascii(m->handle, m->desc->iManufacturer,
-                                              m->manufacturer,
-                                              sizeof(m->manufacturer));
-      if (rc <= 0)
-        fprintf(stderr, ">> Could nor read device manufacturer (%s)\n",
-                libusb_error_name(rc));
+static const uint16_t mtx_neon_indices[8] = {0, 1, 2, 3, 4, 5, 6, 7};
 
-      rc = libusb_get_string_descriptor_ascii(m->handle, m->desc->iProduct,
-                                              m->product, sizeof(m->product));
-      if (rc <= 0)
-        fprintf(stderr, ">> Could nor read device name (%s)\n",
-                libusb_error_name(rc));
+static inline void centroid_acc_neon(uint16x8_t x, uint16x8_t idx,
+                                     uint16x8_t tv, uint64x2_t *vn,
+                                     uint32x4_t *vd) {
+  x = vandq_u16(x, vcgeq_u16(x, tv));
+  *vn = vpadalq_u32(*vn, vmull_u16(vget_low_u16(x), vget_low_u16(idx)));
+  *vn = vpadalq_u32(*vn, vmull_u16(vget_high_u16(x), vget_high_u16(idx)));
+  *vd = vpadalq_u16(*vd, x);
+}
 
-      fprintf(stderr, "> Found device: %s - %s\n", m->manufacturer, m->product);
+static inline void centroid_sum_neon(uint64x2_t vn, uint32x4_t vd,
+                                     uint64_t *num, uint64_t *den) {
+  *num = vgetq_lane_u64(vn, 0) + vgetq_lane_u64(vn, 1);
+  *den = (uint64_t)vgetq_lane_u32(vd, 0) + vgetq_lane_u32(vd, 1) +
+         vgetq_lane_u32(vd, 2) + vgetq_lane_u32(vd, 3);
+}
 
-      mightex_get_version(m);
-      fprintf(stderr, "> Version: %s\n", mightex_version(m));
+static void centroid_neon(const uint16_t *data, int len, uint16_t thr,
+                          uint64_t *num, uint64_t *den) {
+  int i;
+  uint16x8_t tv = vdupq_n_u16(thr);
+  uint16x8_t idx = vld1q_u16(mtx_neon_indices);
+  uint16x8_t step = vdupq_n_u16(8);
+  uint64x2_t vn = vdupq_n_u64(0);
+  uint32x4_t vd = vdupq_n_u32(0);
+  for (i = 0; i + 8 <= len; i += 8) {
+    centroid_acc_neon(vld1q_u16(data + i), idx, tv, &vn, &vd);
+    idx = vaddq_u16(idx, step);
+  }
+  centroid_sum_neon(vn, vd, num, den);
+  centroid_scalar(data, i, len, thr, num, den);
+}
 
-      mightex_get_info(m);
-      fprintf(stderr, "> SerialNo.: %s\n", mightex_serial_no(m));
+static void dark_centroid_neon(const uint16_t *src, uint16_t *dst, int len,
+                               uint16_t dark, uint16_t thr, uint64_t *num,
+                               uint64_t *den) {
+  int i;
+  uint16x8_t dv = vdupq_n_u16(dark);
+  uint16x8_t tv = vdupq_n_u16(thr);
+  uint16x8_t idx = vld1q_u16(mtx_neon_indices);
+  uint16x8_t step = vdupq_n_u16(8);
+  uint64x2_t vn = vdupq_n_u64(0);
+  uint32x4_t vd = vdupq_n_u32(0);
+  for (i = 0; i + 8 <= len; i += 8) {
+    uint16x8_t x = vqsubq_u16(vld1q_u16(src + i), dv);
+    vst1q_u16(dst + i, x);
+    centroid_acc_neon(x, idx, tv, &vn, &vd);
+    idx = vaddq_u16(idx, step);
+  }
+  centroid_sum_neon(vn, vd, num, den);
+  dark_centroid_scalar(src, dst, i, len, dark, thr, num, den);
+}
+#endif
 
-      break;
-    } else {
-      m->dev = NULL;
-    }
+static void sub_sat(uint16_t *data, int len, uint16_t v) {
+#ifdef MTX_AVX2
+  if (cpu_has_avx2()) {
+    sub_sat_avx2(data, len, v);
+    return;
   }
-  libusb_free_device_list(devs, 1);
-  if (m->dev == NULL) {
-    m = NULL;
+#endif
+#if defined(MTX_SSE2)
+  sub_sat_sse2(data, len, v);
+#elif defined(MTX_NEON)
+  sub_sat_neon(data, len, v);
+#else
+  sub_sat_scalar(data, len, v);
+#endif
+}
+
+static void centroid(const uint16_t *data, int len, uint16_t thr,
+                     uint64_t *num, uint64_t *den) {
+#ifdef MTX_AVX2
+  if (cpu_has_avx2()) {
+    centroid_avx2(data, len, thr, num, den);
+    return;
   }
-  return m;
+#endif
+#if defined(MTX_SSE2)
+  centroid_sse2(data, len, thr, num, den);
+#elif defined(MTX_NEON)
+  centroid_neon(data, len, thr, num, den);
+#else
+  *num = *den = 0;
+  centroid_scalar(data, 0, len, thr, num, den);
+#endif
 }
 
-void mightex_close(mightex_t *m) {
-  int rc;
-  if (!m)
+static void dark_centroid(const uint16_t *src, uint16_t *dst, int len,
+                          uint16_t dark, uint16_t thr, uint64_t *num,
+                          uint64_t *den) {
+#ifdef MTX_AVX2
+  if (cpu_has_avx2()) {
+    dark_centroid_avx2(src, dst, len, dark, thr, num, den);
     return;
-  if (m->handle) {
-    rc = libusb_release_interface(m->handle, 0);
-    if (rc != LIBUSB_SUCCESS)
-      fprintf(stderr, ">> Could not release interface (%s)\n",
-              libusb_error_name(rc));
-    libusb_close(m->handle);
   }
-  libusb_exit(m->ctx);
-  free(m);
+#endif
+#if defined(MTX_SSE2)
+  dark_centroid_sse2(src, dst, len, dark, thr, num, den);
+#elif defined(MTX_NEON)
+  dark_centroid_neon(src, dst, len, dark, thr, num, den);
+#else
+  *num = *den = 0;
+  dark_centroid_scalar(src, dst, 0, len, dark, thr, num, den);
+#endif
 }
 
-mtx_result_t mightex_set_mode(mightex_t *m, mtx_mode_t mode) {
-  BYTE mode_b = (BYTE)mode;
-  BYTE buf[3] = {MTX_CMD_MODE, 0x01, mode_b};
-  return mightex_send(m, buf, sizeof(buf));
+// Per-pixel correction: data[i] = (data[i] - dark[i]) * gain[i], with gain in
+// fixed point (MTX_GAIN_BITS fractional bits), saturating at both ends
+
+static void dark_gain_scalar(uint16_t *data, const uint16_t *dark,
+                             const uint16_t *gain, int i0, int len) {
+  int i;
+  uint32_t v;
+  for (i = i0; i < len; i++) {
+    v = data[i] < dark[i] ? 0 : data[i] - dark[i];
+    v = (v * gain[i]) >> MTX_GAIN_BITS;
+    data[i] = v > 65535 ? 65535 : (uint16_t)v;
+  }
 }
 
-// t is in ms
-mtx_result_t mightex_set_exptime(mightex_t *m, float t) {
-  BYTE buf[4];
-  uint16_t val = htons((uint16_t)(t * 10));
-  buf[0] = MTX_CMD_EXPTIME;
-  buf[1] = 0x02;
-  memcpy(buf + 2, &val, sizeof(val));
-  return mightex_send(m, buf, sizeof(buf));
+#ifdef MTX_SSE2
+static void dark_gain_sse2(uint16_t *data, const uint16_t *dark,
+                           const uint16_t *gain, int len) {
+  int i;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi16(-1);
+  for (i = 0; i + 8 <= len; i += 8) {
+    __m128i x = _mm_loadu_si128((__m128i *)(data + i));
+    __m128i g = _mm_loadu_si128((const __m128i *)(gain + i));
+    __m128i lo, hi, r, fits;
+    x = _mm_subs_epu16(x, _mm_loadu_si128((const __m128i *)(dark + i)));
+    lo = _mm_mullo_epi16(x, g);
+    hi = _mm_mulhi_epu16(x, g);
+    // the 32-bit product, shifted, fits in 16 bits if hi is small enough
+    r = _mm_or_si128(_mm_slli_epi16(hi, 16 - MTX_GAIN_BITS),
+                     _mm_srli_epi16(lo, MTX_GAIN_BITS));
+    fits = _mm_cmpeq_epi16(_mm_srli_epi16(hi, MTX_GAIN_BITS), zero);
+    r = _mm_or_si128(r, _mm_andnot_si128(fits, ones));
+    _mm_storeu_si128((__m128i *)(data + i), r);
+  }
+  dark_gain_scalar(data, dark, gain, i, len);
 }
+#endif
 
-int mightex_get_buffer_count(mightex_t *m) {
-  int rc;
-  BYTE buf[3] = {MTX_CMD_BUFFEREDFRAMES, 0x01, 0x00};
-  mightex_send(m, buf, 2);
-  rc = mightex_receive(m, buf, sizeof(buf));
-  if (rc <= 0)
-    return rc;
-  return (int)buf[2];
+#ifdef MTX_AVX2
+MTX_TARGET_AVX2
+static void dark_gain_avx2(uint16_t *data, const uint16_t *dark,
+                           const uint16_t *gain, int len) {
+  int i;
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i ones = _mm256_set1_epi16(-1);
+  for (i = 0; i + 16 <= len; i += 16) {
+    __m256i x = _mm256_loadu_si256((__m256i *)(data + i));
+    __m256i g = _mm256_loadu_si256((const __m256i *)(gain + i));
+    __m256i lo, hi, r, fits;
+    x = _mm256_subs_epu16(x, _mm256_loadu_si256((const __m256i *)(dark + i)));
+    lo = _mm256_mullo_epi16(x, g);
+    hi = _mm256_mulhi_epu16(x, g);
+    r = _mm256_or_si256(_mm256_slli_epi16(hi, 16 - MTX_GAIN_BITS),
+                        _mm256_srli_epi16(lo, MTX_GAIN_BITS));
+    fits = _mm256_cmpeq_epi16(_mm256_srli_epi16(hi, MTX_GAIN_BITS), zero);
+    r = _mm256_or_si256(r, _mm256_andnot_si256(fits, ones));
+    _mm256_storeu_si256((__m256i *)(data + i), r);
+  }
+  dark_gain_scalar(data, dark, gain, i, len);
 }
+#endif
 
-mtx_result_t mightex_read_frame(mightex_t *m) {
-  int i, rc;
-  mightex_prepare_buffered_data(m, 1);
-  rc = libusb_bulk_transfer(m->handle, MTX_EP_FRAME, m->frames[0].buf,
-                            sizeof(m->frames[0].frame), NULL, m->timeout);
-  if (rc != LIBUSB_SUCCESS) {
-    return MTX_FAIL;
+#ifdef MTX_NEON
+static void dark_gain_neon(uint16_t *data, const uint16_t *dark,
+                           const uint16_t *gain, int len) {
+  int i;
+  for (i = 0; i + 8 <= len; i += 8) {
+    uint16x8_t x = vqsubq_u16(vld1q_u16(data + i), vld1q_u16(dark + i));
+    uint16x8_t g = vld1q_u16(gain + i);
+    uint32x4_t lo = vmull_u16(vget_low_u16(x), vget_low_u16(g));
+    uint32x4_t hi = vmull_u16(vget_high_u16(x), vget_high_u16(g));
+    vst1q_u16(data + i, vcombine_u16(vqshrn_n_u32(lo, MTX_GAIN_BITS),
+                                     vqshrn_n_u32(hi, MTX_GAIN_BITS)));
   }
-  m->dark_mean = 0;
-  for (i = 0; i < MTX_DARK_PIXELS; i++) {
-    m->dark_mean += m->frames[0].frame.light_shield[i];
+  dark_gain_scalar(data, dark, gain, i, len);
+}
+#endif
+
+static void dark_gain(uint16_t *data, const uint16_t *dark,
+                      const uint16_t *gain, int len) {
+#ifdef MTX_AVX2
+  if (cpu_has_avx2()) {
+    dark_gain_avx2(data, dark, gain, len);
+    return;
   }
-  m->dark_mean /= MTX_DARK_PIXELS;
-  memcpy(m->data, m->frames[0].frame.image_data, MTX_PIXELS * sizeof(uint16_t));
-  return MTX_OK;
+#endif
+#if defined(MTX_SSE2)
+  dark_gain_sse2(data, dark, gain, len);
+#elif defined(MTX_NEON)
+  dark_gain_neon(data, dark, gain, len);
+#else
+  dark_gain_scalar(data, dark, gain, 0, len);
+#endif
 }
 
-void mightex_gpio_write(mightex_t *m, BYTE reg, BYTE val) {
-  BYTE buf[4] = {MTX_CMD_GPIOWRITE, 0x02, reg, val};
-  mightex_send(m, buf, sizeof(buf));
+// Accumulation: sum[i] += x[i] and sq[i] += x[i]^2, widening to 32 and 64
+// bits; acc_replace() also takes out the oldest frame o, in the same pass.
+// Sums wrap around, so that taking out a frame is always exact. The loops are
+// bound by memory traffic, so they are left to the compiler.
+
+static void acc_add(uint32_t *sum, uint64_t *sq, const uint16_t *x, int len) {
+  int i;
+  for (i = 0; i < len; i++) {
+    sum[i] += x[i];
+    sq[i] += (uint32_t)x[i] * x[i];
+  }
 }
 
-BYTE mightex_gpio_read(mightex_t *m, BYTE reg) {
-  int rc;
-  BYTE buf[3] = {MTX_CMD_GPIOREAD, 0x03, reg};
-  mightex_send(m, buf, sizeof(buf));
-  rc = mightex_receive(m, buf, sizeof(buf));
-  if (rc <= 0)
-    return -1;
-  return buf[2];
+static void acc_replace(uint32_t *sum, uint64_t *sq, const uint16_t *x,
+                        const uint16_t *o, int len) {
+  int i;
+  for (i = 0; i < len; i++) {
+    sum[i] += (uint32_t)x[i] - o[i];
+    sq[i] += (uint64_t)((uint32_t)x[i] * x[i]) - (uint32_t)o[i] * o[i];
+  }
 }
 
-void mightex_apply_filter(mightex_t *m, void *ud) {
-  if (m->filter)
-    m->filter(m, m->data, MTX_PIXELS, ud);
+// Statistics: minimum, maximum, sum, sum of squares and count of the pixels
+// not below sat, all in integers. Sums of up to 65535 pixels fit in 64 bits.
+typedef struct {
+  uint16_t min, max;
+  uint64_t sum, sq;
+  uint32_t saturated;
+} mtx_stats_acc_t;
+
+static void stats_scalar(const uint16_t *data, int i0, int len, uint16_t sat,
+                         mtx_stats_acc_t *a) {
+  int i;
+  uint16_t v;
+  for (i = i0; i < len; i++) {
+    v = data[i];
+    a->min = v < a->min ? v : a->min;
+    a->max = v > a->max ? v : a->max;
+    a->sum += v;
+    a->sq += (uint32_t)v * v;
+    a->saturated += v >= sat;
+  }
 }
 
-double mightex_apply_estimator(mightex_t *m, void *ud) {
-  if (m->estimator)
-    return m->estimator(m, m->data, MTX_PIXELS, ud);
-  else
-    return 0.0;
+#ifdef MTX_SSE2
+static void stats_sse2(const uint16_t *data, int len, uint16_t sat,
+                       mtx_stats_acc_t *a) {
+  int i, k;
+  const __m128i zero = _mm_setzero_si128();
+  // SSE2 only has signed 16-bit min and max: flip the sign bit
+  const __m128i flip = _mm_set1_epi16((short)0x8000);
+  __m128i sv = _mm_set1_epi16((short)sat);
+  __m128i vmin = _mm_set1_epi16(0x7FFF), vmax = _mm_set1_epi16(-0x8000);
+  __m128i vs = zero, vq = zero, vc = zero;
+  uint16_t lanes[8];
+  uint32_t s32[4];
+  uint64_t q64[2];
+  for (i = 0; i + 8 <= len; i += 8) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(data + i));
+    __m128i f = _mm_xor_si128(x, flip);
+    __m128i lo = _mm_mullo_epi16(x, x), hi = _mm_mulhi_epu16(x, x);
+    __m128i q0 = _mm_unpacklo_epi16(lo, hi), q1 = _mm_unpackhi_epi16(lo, hi);
+    vmin = _mm_min_epi16(vmin, f);
+    vmax = _mm_max_epi16(vmax, f);
+    vs = _mm_add_epi32(vs, _mm_add_epi32(_mm_unpacklo_epi16(x, zero),
+                                         _mm_unpackhi_epi16(x, zero)));
+    vq = _mm_add_epi64(vq, _mm_unpacklo_epi32(q0, zero));
+    vq = _mm_add_epi64(vq, _mm_unpackhi_epi32(q0, zero));
+    vq = _mm_add_epi64(vq, _mm_unpacklo_epi32(q1, zero));
+    vq = _mm_add_epi64(vq, _mm_unpackhi_epi32(q1, zero));
+    // x >= sat exactly when sat - x saturates to 0; the mask is -1
+    vc = _mm_sub_epi16(vc, _mm_cmpeq_epi16(_mm_subs_epu16(sv, x), zero));
+  }
+  _mm_storeu_si128((__m128i *)lanes, _mm_xor_si128(vmin, flip));
+  for (k = 0; k < 8; k++)
+    a->min = lanes[k] < a->min ? lanes[k] : a->min;
+  _mm_storeu_si128((__m128i *)lanes, _mm_xor_si128(vmax, flip));
+  for (k = 0; k < 8; k++)
+    a->max = lanes[k] > a->max ? lanes[k] : a->max;
+  _mm_storeu_si128((__m128i *)lanes, vc);
+  for (k = 0; k < 8; k++)
+    a->saturated += lanes[k];
+  _mm_storeu_si128((__m128i *)s32, vs);
+  a->sum += (uint64_t)s32[0] + s32[1] + s32[2] + s32[3];
+  _mm_storeu_si128((__m128i *)q64, vq);
+  a->sq += q64[0] + q64[1];
+  stats_scalar(data, i, len, sat, a);
 }
+#endif
 
-//      _
-//     / \   ___ ___ ___  ___ ___  ___  _ __ ___
-//    / _ \ / __/ __/ _ \/ __/ __|/ _ \| '__/ __|
+#ifdef MTX_AVX2
+MTX_TARGET_AVX2
+static void stats_avx2(const uint16_t *data, int len, uint16_t sat,
+                       mtx_stats_acc_t *a) {
+  int i, k;
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i sv = _mm256_set1_epi16((short)sat);
+  __m256i vmin = _mm256_set1_epi16(-1), vmax = zero;
+  __m256i vs = zero, vq = zero, vc = zero;
+  uint16_t lanes[16];
+  uint32_t s32[8];
+  uint64_t q64[4];
+  for (i = 0; i + 16 <= len; i += 16) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(data + i));
+    __m256i lo = _mm256_mullo_epi16(x, x), hi = _mm256_mulhi_epu16(x, x);
+    __m256i q0 = _mm256_unpacklo_epi16(lo, hi);
+    __m256i q1 = _mm256_unpackhi_epi16(lo, hi);
+    vmin = _mm256_min_epu16(vmin, x);
+    vmax = _mm256_max_epu16(vmax, x);
+    vs = _mm256_add_epi32(vs, _mm256_add_epi32(_mm256_unpacklo_epi16(x, zero),
+                                               _mm256_unpackhi_epi16(x, zero)));
+    vq = _mm256_add_epi64(vq, _mm256_unpacklo_epi32(q0, zero));
+    vq = _mm256_add_epi64(vq, _mm256_unpackhi_epi32(q0, zero));
+    vq = _mm256_add_epi64(vq, _mm256_unpacklo_epi32(q1, zero));
+    vq = _mm256_add_epi64(vq, _mm256_unpackhi_epi32(q1, zero));
+    vc = _mm256_sub_epi16(vc, _mm256_cmpeq_epi16(_mm256_subs_epu16(sv, x),
+                                                 zero));
+  }
+  _mm256_storeu_si256((__m256i *)lanes, vmin);
+  for (k = 0; k < 16; k++)
+    a->min = lanes[k] < a->min ? lanes[k] : a->min;
+  _mm256_storeu_si256((__m256i *)lanes, vmax);
+  for (k = 0; k < 16; k++)
+    a->max = lanes[k] > a->max ? lanes[k] : a->max;
+  _mm256_storeu_si256((__m256i *)lanes, vc);
+  for (k = 0; k < 16; k++)
+    a->saturated += lanes[k];
+  _mm256_storeu_si256((__m256i *)s32, vs);
+  for (k = 0; k < 8; k++)
+    a->sum += s32[k];
+  _mm256_storeu_si256((__m256i *)q64, vq);
+  a->sq += q64[0] + q64[1] + q64[2] + q64[3];
+  stats_scalar(data, i, len, sat, a);
+}
+#endif
+
+#ifdef MTX_NEON
+static void stats_neon(const uint16_t *data, int len, uint16_t sat,
+                       mtx_stats_acc_t *a) {
+  int i;
+  uint16x8_t sv = vdupq_n_u16(sat);
+  uint16x8_t vmin = vdupq_n_u16(0xFFFF), vmax = vdupq_n_u16(0);
+  uint16x8_t vc = vdupq_n_u16(0);
+  uint32x4_t vs = vdupq_n_u32(0);
+  uint64x2_t vq = vdupq_n_u64(0);
+  for (i = 0; i + 8 <= len; i += 8) {
+    uint16x8_t x = vld1q_u16(data + i);
+    vmin = vminq_u16(vmin, x);
+    vmax = vmaxq_u16(vmax, x);
+    vs = vpadalq_u16(vs, x);
+    vq = vpadalq_u32(vq, vmull_u16(vget_low_u16(x), vget_low_u16(x)));
+    vq = vpadalq_u32(vq, vmull_u16(vget_high_u16(x), vget_high_u16(x)));
+    // the mask is all ones, i.e. 1 once shifted
+    vc = vaddq_u16(vc, vshrq_n_u16(vcgeq_u16(x, sv), 15));
+  }
+  a->min = vminvq_u16(vmin) < a->min ? vminvq_u16(vmin) : a->min;
+  a->max = vmaxvq_u16(vmax) > a->max ? vmaxvq_u16(vmax) : a->max;
+  a->saturated += vaddlvq_u16(vc);
+  a->sum += vaddlvq_u32(vs);
+  a->sq += vgetq_lane_u64(vq, 0) + vgetq_lane_u64(vq, 1);
+  stats_scalar(data, i, len, sat, a);
+}
+#endif
+
+// Histogram of the top bits of the values. Neighbouring pixels mostly fall
+// in the same bin, so small histograms are split in four partial ones, to
+// avoid waiting on the previous increment of the same counter.
+#define MTX_HIST_SPLIT_BITS 10
+
+static void histogram(const uint16_t *data, int len, int bits, uint32_t *h) {
+  int i, n = 1 << bits, shift = 16 - bits;
+  uint32_t part[4][1 << MTX_HIST_SPLIT_BITS];
+  if (bits > MTX_HIST_SPLIT_BITS) {
+    memset(h, 0, n * sizeof(uint32_t));
+    for (i = 0; i < len; i++)
+      h[data[i] >> shift]++;
+    return;
+  }
+  for (i = 0; i < 4; i++)
+    memset(part[i], 0, n * sizeof(uint32_t));
+  for (i = 0; i + 4 <= len; i += 4) {
+    part[0][data[i] >> shift]++;
+    part[1][data[i + 1] >> shift]++;
+    part[2][data[i + 2] >> shift]++;
+    part[3][data[i + 3] >> shift]++;
+  }
+  for (; i < len; i++)
+    part[0][data[i] >> shift]++;
+  for (i = 0; i < n; i++)
+    h[i] = part[0][i] + part[1][i] + part[2][i] + part[3][i];
+}
+
+static void stats(const uint16_t *data, int len, uint16_t sat,
+                  mtx_stats_acc_t *a) {
+  a->min = 0xFFFF;
+  a->max = 0;
+  a->sum = a->sq = 0;
+  a->saturated = 0;
+#ifdef MTX_AVX2
+  if (cpu_has_avx2()) {
+    stats_avx2(data, len, sat, a);
+    return;
+  }
+#endif
+#if defined(MTX_SSE2)
+  stats_sse2(data, len, sat, a);
+#elif defined(MTX_NEON)
+  stats_neon(data, len, sat, a);
+#else
+  stats_scalar(data, 0, len, sat, a);
+#endif
+}
+
+static void filter_dark(mightex_t *m, uint16_t *const data, uint16_t len,
+                        void *ud) {
+  sub_sat(data, len, m->dark_mean);
+}
+
+// Index of the first pixel of a window passed to a filter or estimator, 0 for
+// buffers other than the frame data
+static int data_offset(mightex_t *m, const uint16_t *data) {
+  const uint16_t *base = m->cur->view;
+  if (base && data >= base && data < base + MTX_PIXELS)
+    return (int)(data - base);
+  base = ccd_pixels(&m->cur->frames[0]);
+  if (data >= base && data < base + MTX_PIXELS)
+    return (int)(data - base);
+  return 0;
+}
+
+// Integer sums are exact, so the result is the same as accumulating doubles,
+// and the same on a window holding all the pixels above threshold as on the
+// full frame
+static double estimator_center(mightex_t *m, uint16_t *const data, uint16_t len,
+                               void *ud) {
+  uint64_t num, den;
+  uint16_t thr = m->dark_mean * 3;
+  centroid(data, len, thr, &num, &den);
+  num += (uint64_t)data_offset(m, data) * den;
+  return (double)num / (double)den;
+}
+
+// Multi-peak estimator: a single pass splitting the pixels not below the
+// threshold into runs, each run being a peak. Sums are kept in integers, as in
+// estimator_center().
+static int estimator_peaks(mightex_t *m, uint16_t *const data, uint16_t len,
+                           void *ud, double *out, int max) {
+  const mightex_peak_options_t *opt = (const mightex_peak_options_t *)ud;
+  uint16_t thr = opt && opt->threshold ? opt->threshold : m->dark_mean * 3;
+  int min_width = opt ? opt->min_width : 0;
+  int i, start, n = 0, x0 = data_offset(m, data);
+  uint64_t num;
+  uint32_t den;
+  uint16_t peak, v;
+  mightex_peak_t *p;
+
+  i = 0;
+  while (n + MTX_PEAK_VALUES <= max) {
+    // tight loops for the background and for the run, which are the hot paths
+    while (i < len && data[i] < thr)
+      i++;
+    if (i == len)
+      break;
+    start = i;
+    num = den = peak = 0;
+    while (i < len && (v = data[i]) >= thr) {
+      num += (uint32_t)i * v;
+      den += v;
+      peak = v > peak ? v : peak;
+      i++;
+    }
+    if (i - start < min_width)
+      continue;
+    p = (mightex_peak_t *)(out + n);
+    p->centroid = (double)(num + (uint64_t)x0 * den) / (double)den;
+    p->amplitude = peak;
+    p->width = i - start;
+    p->energy = den;
+    n += MTX_PEAK_VALUES;
+  }
+  return n;
+}
+
+// Regions of interest
+//
+// Filters work on the spans covered by the windows, sorted and merged so that
+// no pixel is filtered twice; the scalar estimator works on window 0, the one
+// that can track the estimate. While searching, both see the full frame.
+
+static int roi_spans(mightex_t *m, mightex_roi_t *spans) {
+  int i, j, n = 0;
+  mightex_roi_t w;
+  if (m->n_roi == 0 || m->searching) {
+    spans[0].start = 0;
+    spans[0].width = MTX_PIXELS;
+    return 1;
+  }
+  // insertion sort by start, merging the overlapping or adjacent windows
+  for (i = 0; i < m->n_roi; i++) {
+    w = m->roi[i];
+    for (j = n; j > 0 && spans[j - 1].start > w.start; j--)
+      spans[j] = spans[j - 1];
+    spans[j] = w;
+    n++;
+  }
+  for (i = 1, j = 0; i < n; i++) {
+    if (spans[i].start <= spans[j].start + spans[j].width) {
+      w.start = spans[i].start + spans[i].width;
+      if (w.start > spans[j].start + spans[j].width)
+        spans[j].width = w.start - spans[j].start;
+    } else {
+      spans[++j] = spans[i];
+    }
+  }
+  return j + 1;
+}
+
+static mightex_roi_t roi_primary(mightex_t *m) {
+  mightex_roi_t w = {0, MTX_PIXELS};
+  if (m->n_roi > 0 && !m->searching)
+    w = m->roi[0];
+  return w;
+}
+
+// Copy the raw pixels outside the sorted spans to the view, those a pass over
+// the spans alone leaves out
+static void roi_fill_outside(const uint16_t *raw, uint16_t *data,
+                             const mightex_roi_t *spans, int n) {
+  int i, end = 0;
+  for (i = 0; i < n; i++) {
+    memcpy(data + end, raw + end, (spans[i].start - end) * sizeof(uint16_t));
+    end = spans[i].start + spans[i].width;
+  }
+  memcpy(data + end, raw + end, (MTX_PIXELS - end) * sizeof(uint16_t));
+}
+
+// Recentre window 0 on a valid estimate, or search the full frame on the next
+// call when the estimate is lost (NaN or out of the sensor)
+static void roi_track(mightex_t *m, double x) {
+  int start, width;
+  if (!m->tracking || m->n_roi == 0)
+    return;
+  if (!(x >= 0 && x < MTX_PIXELS)) {
+    if (!m->searching)
+      m->searches++;
+    m->searching = 1;
+    return;
+  }
+  width = m->roi[0].width;
+  start = (int)(x + 0.5) - width / 2;
+  if (start < 0)
+    start = 0;
+  if (start > MTX_PIXELS - width)
+    start = MTX_PIXELS - width;
+  m->roi[0].start = (uint16_t)start;
+  m->searching = 0;
+}
+
+static double mtx_now_us(void) {
+#ifdef _WIN32
+  LARGE_INTEGER f, t;
+  QueryPerformanceFrequency(&f);
+  QueryPerformanceCounter(&t);
+  return (double)t.QuadPart * 1.0E6 / (double)f.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1.0E6 + ts.tv_nsec / 1.0E3;
+#endif
+}
+
+static void mtx_sleep_us(double us) {
+  if (us <= 0)
+    return;
+#ifdef _WIN32
+  Sleep((DWORD)(us / 1000.0 + 0.5));
+#else
+  struct timespec ts;
+  ts.tv_sec = (time_t)(us / 1.0E6);
+  ts.tv_nsec = (long)((us - ts.tv_sec * 1.0E6) * 1.0E3);
+  nanosleep(&ts, NULL);
+#endif
+}
+
+// Simulated device
+//
+// The simulator speaks the camera protocol at the bulk transfer level, so that
+// everything above mightex_bulk() runs unchanged. Lines are exposed at a fixed
+// period, at most 4 of them are kept in the buffer, and USB costs are modeled
+// with MTX_SIM_LATENCY_US and MTX_SIM_XFER_US.
+
+static uint32_t sim_rand(mtx_sim_t *s) {
+  s->seed ^= s->seed << 13;
+  s->seed ^= s->seed >> 17;
+  s->seed ^= s->seed << 5;
+  return s->seed;
+}
+
+static void sim_set_exptime(mtx_sim_t *s, float t) {
+  int i, j;
+  double amp, x, v;
+  s->exptime = t;
+  // the light of the scene, growing with exposure, over the dark signal
+  amp = 2000.0 * t;
+  if (amp > 65535 - MTX_SIM_DARK)
+    amp = 65535 - MTX_SIM_DARK;
+  for (i = 0; i < MTX_PIXELS; i++) {
+    x = (i - MTX_PIXELS / 2) / 20.0;
+    switch (s->scene) {
+    case MTX_SCENE_SPOT:
+      v = amp * exp(-x * x / 2);
+      break;
+    case MTX_SCENE_FLAT:
+      v = amp / 2;
+      break;
+    case MTX_SCENE_LINES:
+      v = 0;
+      for (j = 1; j <= 3; j++) {
+        x = (i - j * MTX_PIXELS / 4) / 5.0;
+        v += amp / j * exp(-x * x / 2);
+      }
+      break;
+    default:
+      v = 0;
+    }
+    v = MTX_SIM_DARK + s->dsnu[i] + v * s->prnu[i];
+    s->profile[i] = v < 65535 - 0x3F ? (uint16_t)v : 65535 - 0x3F;
+  }
+}
+
+// Restart the line clock at time now. In trigger mode lines follow the
+// simulated trigger source, and the triggers coming while a line is still
+// being exposed are missed (but counted)
+static void sim_restart(mtx_sim_t *s, double now) {
+  double period = s->exptime * 1000.0;
+  if (period < MTX_SIM_MIN_PERIOD_US)
+    period = MTX_SIM_MIN_PERIOD_US;
+  if (s->trigger_step) {
+    s->produced = (unsigned long)((now - s->t_start) / s->period);
+    s->trigger_base += s->produced * s->trigger_step;
+    s->trigger_step = 0;
+  }
+  if (s->mode == MTX_TRIGGER_MODE) {
+    if (s->trigger_period > 0) {
+      s->trigger_step = (unsigned int)ceil(period / s->trigger_period);
+      period = s->trigger_step * s->trigger_period;
+    } else {
+      s->trigger_step = 1;
+      period = MTX_SIM_NO_TRIGGER_US;
+    }
+  }
+  s->period = period;
+  s->t_start = now;
+  s->produced = s->consumed = 0;
+}
+
+// Advance the sensor to time now: lines older than the 4 buffered ones are lost
+static int sim_available(mtx_sim_t *s, double now) {
+  s->produced = (unsigned long)((now - s->t_start) / s->period);
+  if (s->produced - s->consumed > 4)
+    s->consumed = s->produced - 4;
+  return (int)(s->produced - s->consumed);
+}
+
+// Time at which the next line to be handed over is complete
+static double sim_next_ready(mtx_sim_t *s) {
+  return s->t_start + (s->consumed + 1) * s->period;
+}
+
+static void sim_fill_frame(mtx_sim_t *s, ccd_frames_t *f) {
+  int i;
+  memset(f->buf, 0, sizeof(f->buf));
+  for (i = 0; i < MTX_DARK_PIXELS; i++)
+    f->frame.light_shield[i] = MTX_SIM_DARK + (sim_rand(s) & 0x3F);
+  for (i = 0; i < MTX_PIXELS; i++)
+    f->frame.image_data[i] = s->profile[i] + (sim_rand(s) & 0x3F);
+  f->frame.time_stamp = (uint16_t)(sim_next_ready(s) / 1000.0);
+  f->frame.exposure_time = (uint16_t)(s->exptime * 10 + 0.5);
+  if (s->trigger_step) {
+    f->frame.trigger_occurred = 1;
+    f->frame.trigger_event_count =
+        (uint16_t)(s->trigger_base + (s->consumed + 1) * s->trigger_step);
+  }
+  s->consumed++;
+}
+
+static mtx_sim_t *sim_new(void) {
+  int i;
+  mtx_sim_t *s = calloc(1, sizeof(mtx_sim_t));
+  if (!s)
+    return NULL;
+  s->seed = 0x1304;
+  // up to 255 counts of dark signal and +/-5% of response non-uniformity
+  for (i = 0; i < MTX_PIXELS; i++) {
+    s->dsnu[i] = sim_rand(s) & 0xFF;
+    s->prnu[i] = 1.0f + ((int)(sim_rand(s) & 0xFF) - 128) / 2560.0f;
+  }
+  sim_set_exptime(s, 1.0);
+  sim_restart(s, mtx_now_us());
+#ifdef MTX_THREADS
+  pthread_mutex_init(&s->lock, NULL);
+#endif
+  return s;
+}
+
+static void sim_free(mtx_sim_t *s) {
+#ifdef MTX_THREADS
+  pthread_mutex_destroy(&s->lock);
+#endif
+  free(s);
+}
+
+// Return 0 if the simulated device is on the bus, 1 if unplugged, 2 if it
+// has just come back (in power-on state)
+static int sim_hotplug(mtx_sim_t *s) {
+  int state = 0;
+  double now;
+  SIM_LOCK(s);
+  now = mtx_now_us();
+  if (s->unplugged_until > 0) {
+    state = 1;
+    if (now >= s->unplugged_until) {
+      s->unplugged_until = 0;
+      s->mode = MTX_NORMAL_MODE;
+      s->trigger_step = 0;
+      s->trigger_base = 0;
+      sim_set_exptime(s, 1.0);
+      sim_restart(s, now);
+      s->pending = 0;
+      s->reply_len = 0;
+      state = 2;
+    }
+  }
+  SIM_UNLOCK(s);
+  return state;
+}
+
+static int sim_transact(mtx_sim_t *s, unsigned char ep, BYTE *buf, int len,
+                        int *transferred) {
+  int n = 0;
+  uint16_t val;
+  double now;
+
+  mtx_sleep_us(MTX_SIM_LATENCY_US);
+  now = mtx_now_us();
+  if (s->unplugged_until > 0)
+    return LIBUSB_ERROR_NO_DEVICE;
+  switch (ep) {
+  case MTX_EP_CMD:
+    s->reply_len = 0;
+    memset(s->reply, 0, sizeof(s->reply));
+    s->reply[0] = MTX_OK;
+    switch (buf[0]) {
+    case MTX_CMD_FIRMWARE:
+      s->reply[1] = 3;
+      s->reply[2] = 1;
+      s->reply[3] = 0;
+      s->reply[4] = 0;
+      s->reply_len = 5;
+      break;
+    case MTX_CMD_INFO:
+      s->reply[1] = sizeof(struct di) - 2;
+      memcpy(s->reply + 3, "TCE-1304-U", 10);
+      memcpy(s->reply + 3 + STRING_LENGTH, MTX_SIM_SERIAL,
+             sizeof(MTX_SIM_SERIAL));
+      s->reply_len = sizeof(struct di);
+      break;
+    case MTX_CMD_MODE:
+      s->mode = buf[2];
+      sim_restart(s, now);
+      break;
+    case MTX_CMD_EXPTIME:
+      memcpy(&val, buf + 2, sizeof(val));
+      sim_set_exptime(s, ntohs(val) / 10.0f);
+      sim_restart(s, now);
+      break;
+    case MTX_CMD_BUFFEREDFRAMES:
+      s->reply[1] = 1;
+      s->reply[2] = (BYTE)sim_available(s, now);
+      s->reply_len = 3;
+      break;
+    case MTX_CMD_GETBUFFEREDDATA:
+      s->pending = buf[2];
+      break;
+    case MTX_CMD_GPIOWRITE:
+      s->gpio[buf[2] & 0x03] = buf[3];
+      break;
+    case MTX_CMD_GPIOREAD:
+      s->reply[1] = 1;
+      s->reply[2] = s->gpio[buf[2] & 0x03];
+      s->reply_len = 3;
+      break;
+    default:
+      return LIBUSB_ERROR_PIPE;
+    }
+    n = len;
+    break;
+  case MTX_EP_REPLY:
+    if (s->reply_len == 0)
+      return LIBUSB_ERROR_TIMEOUT;
+    n = len < s->reply_len ? len : s->reply_len;
+    memcpy(buf, s->reply, n);
+    s->reply_len = 0;
+    break;
+  case MTX_EP_FRAME:
+    while (s->pending > 0 && n + (int)sizeof(ccd_frames_t) <= len) {
+      if (sim_available(s, now) == 0) {
+        // e.g. no trigger coming: time out as the device would
+        if (sim_next_ready(s) - now > MTX_TIMEOUT * 1000.0) {
+          mtx_sleep_us(MTX_TIMEOUT * 1000.0);
+          break;
+        }
+        mtx_sleep_us(sim_next_ready(s) - now);
+        now = mtx_now_us();
+        sim_available(s, now);
+      }
+      mtx_sleep_us(MTX_SIM_XFER_US);
+      sim_fill_frame(s, (ccd_frames_t *)(buf + n));
+      n += sizeof(ccd_frames_t);
+      s->pending--;
+    }
+    if (n == 0)
+      return LIBUSB_ERROR_TIMEOUT;
+    break;
+  default:
+    return LIBUSB_ERROR_INVALID_PARAM;
+  }
+  if (transferred)
+    *transferred = n;
+  return LIBUSB_SUCCESS;
+}
+
+static int sim_bulk(mtx_sim_t *s, unsigned char ep, BYTE *buf, int len,
+                    int *transferred) {
+  int rc;
+  SIM_LOCK(s);
+  rc = sim_transact(s, ep, buf, len, transferred);
+  SIM_UNLOCK(s);
+  return rc;
+}
+
+// All synchronous traffic with the camera goes through here
+static int mightex_bulk(mightex_t *m, unsigned char ep, BYTE *buf, int len,
+                        int *transferred) {
+  int rc;
+  CAM_LOCK(m);
+  if (m->sim)
+    rc = sim_bulk(m->sim, ep, buf, len, transferred);
+  else if (m->handle)
+    rc = libusb_bulk_transfer(m->handle, ep, buf, len, transferred,
+                              m->timeout);
+  else
+    rc = LIBUSB_ERROR_NO_DEVICE;
+  CAM_UNLOCK(m);
+  if (rc == LIBUSB_ERROR_NO_DEVICE)
+    m->lost = 1;
+  return rc;
+}
+
+static uint16_t frame_dark_mean(const ccd_frames_t *f) {
+  int i;
+  uint32_t dark = 0;
+  for (i = 0; i < MTX_DARK_PIXELS; i++) {
+    dark += f->frame.light_shield[i];
+  }
+  return (uint16_t)(dark / MTX_DARK_PIXELS);
+}
+
+// Exposure time in the units of the camera (0.1 ms)
+static uint16_t exptime_units(float t) { return (uint16_t)(t * 10 + 0.5); }
+
+// Auto-exposure
+//
+// Each frame taken at the current exposure time is compared with the target
+// level, and the correction is scaled by the ratio between the two, as the
+// signal is proportional to the exposure time. The new value is only computed
+// here, possibly within a libusb callback, and is sent to the camera later on
+// by auto_exposure_apply(): at most one change per frame. With the acquisition
+// thread, both run there, on every frame received.
+
+static void auto_exposure_update(mightex_t *m, const ccd_frames_t *f,
+                                 uint16_t dark_mean) {
+  int i;
+  uint16_t peak = 0;
+  unsigned int saturated = 0;
+  double level, ratio, t;
+  mightex_auto_exposure_t *ae = &m->ae;
+
+  if (!m->ae_enabled || m->ae_pending > 0)
+    return;
+  // frames exposed before the last change tell nothing about the current one
+  if (f->frame.exposure_time != exptime_units(m->exptime))
+    return;
+  if (mtx_now_us() - m->ae_last < ae->min_interval_ms * 1000.0)
+    return;
+  for (i = 0; i < MTX_PIXELS; i++) {
+    if (f->frame.image_data[i] > peak)
+      peak = f->frame.image_data[i];
+    if (f->frame.image_data[i] >= ae->saturation)
+      saturated++;
+  }
+  level = peak > dark_mean ? peak - dark_mean : 0;
+  if (saturated > ae->max_saturated)
+    ratio = 1.0 / ae->max_ratio;
+  else if (fabs(level - ae->target) <= ae->tolerance * ae->target)
+    return;
+  else
+    ratio = level > 0 ? ae->target / level : ae->max_ratio;
+  if (ratio > ae->max_ratio)
+    ratio = ae->max_ratio;
+  else if (ratio < 1.0 / ae->max_ratio)
+    ratio = 1.0 / ae->max_ratio;
+  t = m->exptime * ratio;
+  if (t < ae->min_exptime)
+    t = ae->min_exptime;
+  else if (t > ae->max_exptime)
+    t = ae->max_exptime;
+  if (exptime_units(t) != exptime_units(m->exptime))
+    m->ae_pending = exptime_units(t) / 10.0f;
+}
+
+// Send the pending correction; never call from within a libusb callback
+static void auto_exposure_apply(mightex_t *m) {
+  float t = m->ae_pending;
+  if (t <= 0)
+    return;
+  m->ae_pending = 0;
+  m->ae_last = mtx_now_us();
+  if (mightex_set_exptime(m, t) != MTX_OK)
+    fprintf(stderr, ">> Auto-exposure could not set %.1f ms\n", t);
+}
+
+// Triggers missed before frame f, from the gap in the trigger event counter,
+// less the triggered frames that were taken but dropped on the way
+static unsigned int frame_missed_triggers(mightex_t *m, const ccd_frames_t *f,
+                                          unsigned int dropped) {
+  uint16_t gap;
+  int first = !m->trigger_seen;
+  if (m->mode != MTX_TRIGGER_MODE || !f->frame.trigger_occurred)
+    return 0;
+  gap = f->frame.trigger_event_count - m->last_trigger;
+  m->last_trigger = f->frame.trigger_event_count;
+  m->trigger_seen = 1;
+  if (first || gap <= dropped + 1)
+    return 0;
+  m->dropped_triggers += gap - 1 - dropped;
+  return gap - 1 - dropped;
+}
+
+// Frame rings
+//
+// The writer owns the file through an exclusive lock, which goes away with the
+// process, and writes the records with plain stores into the mapping: a frame
+// is recorded as soon as its copy lands. Readers map the file read-only at any
+// time, also after a crash of the writer, as the pages outlive the process; 
+// nothing is flushed to the disk explicitly, though, so a power loss is not 
+// covered. A writer opening an existing ring of the same size goes on after 
+// its last committed frame. The same rings in shared memory publish the frames
+// to other processes, which never make the writer wait.
+
+#ifdef MTX_RINGS
+static size_t ring_size(uint32_t capacity) {
+  return sizeof(mtx_ring_header_t) + (size_t)capacity * sizeof(mtx_record_t);
+}
+
+// Check a header against the layout of this build and the file size
+static int ring_valid(const mtx_ring_header_t *h, size_t size) {
+  return h->magic == MTX_RING_MAGIC && h->version == MTX_RING_VERSION &&
+         h->pixels == MTX_PIXELS && h->record_size == sizeof(mtx_record_t) &&
+         h->capacity > 0 && ring_size(h->capacity) <= size;
+}
+
+// Give the file its blocks now, so that a full disk fails here rather than
+// with a SIGBUS while recording
+static int ring_alloc(int fd, size_t size) {
+#ifdef __APPLE__
+  return ftruncate(fd, (off_t)size);
+#else
+  return posix_fallocate(fd, 0, (off_t)size);
+#endif
+}
+
+static mightex_ring_t *ring_map(int fd, size_t size, int writer) {
+  int prot = PROT_READ, flags = MAP_SHARED;
+  mightex_ring_t *r;
+  void *p;
+  if (writer) {
+    prot |= PROT_WRITE;
+#ifdef MAP_POPULATE
+    // fault the pages in now rather than on the first frames
+    flags |= MAP_POPULATE;
+#endif
+  }
+  p = mmap(NULL, size, prot, flags, fd, 0);
+  if (p == MAP_FAILED)
+    return NULL;
+  r = calloc(1, sizeof(mightex_ring_t));
+  if (!r) {
+    munmap(p, size);
+    return NULL;
+  }
+  r->fd = fd;
+  r->writer = writer;
+  r->size = size;
+  r->header = (mtx_ring_header_t *)p;
+  r->records = (mtx_record_t *)(r->header + 1);
+  return r;
+}
+
+// Write f as the next frame of the ring. Missed triggers are counted here, as
+// frames are recorded by the acquisition thread before they are accounted.
+static void ring_write(mightex_ring_t *r, const ccd_frames_t *f) {
+  uint64_t tag = r->next + 1;
+  mtx_record_t *rec = &r->records[r->next % r->capacity];
+  uint16_t gap;
+  atomic_store_explicit(&rec->begin, tag, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  memcpy(&rec->frame, f, sizeof(ccd_frames_t));
+  rec->dark_mean = frame_dark_mean(f);
+  rec->missed = 0;
+  if (f->frame.trigger_occurred) {
+    gap = f->frame.trigger_event_count - r->last_trigger;
+    if (r->trigger_seen && gap > 1)
+      rec->missed = gap - 1;
+    r->last_trigger = f->frame.trigger_event_count;
+    r->trigger_seen = 1;
+  }
+  atomic_store_explicit(&rec->end, tag, memory_order_release);
+  atomic_store_explicit(&r->header->committed, tag, memory_order_release);
+  r->next = tag;
+}
+
+// Rings are files, or POSIX shared memory objects
+static int ring_fd(const char *name, int flags, int shared) {
+  return shared ? shm_open(name, flags, 0644) : open(name, flags, 0644);
+}
+
+// Lock fd as the one writer; systems that cannot lock it are not checked
+static int ring_lock(int fd) {
+  return flock(fd, LOCK_EX | LOCK_NB) == 0 || errno != EWOULDBLOCK;
+}
+
+static void ring_unmap(mightex_ring_t *r) {
+  munmap(r->header, r->size);
+  free(r);
+}
+
+// Open a ring for writing. A ring of the same size is continued; anything 
+// else is replaced by a new file, so that the readers still mapping the old 
+// one are not affected. The new file is set up under a temporary name and 
+// renamed over the old one, which stays locked until then, so that no other
+// writer gets in meanwhile; shared memory objects cannot be renamed, and are
+// unlinked under the lock instead. The header is checked in the mapping, as 
+// shared memory objects cannot be read everywhere.
+static mightex_ring_t *ring_writer(const char *name, int frames, int shared) {
+  int fd, old = -1;
+  char *tmp = NULL;
+  size_t size;
+  struct stat st;
+  mightex_ring_t *r = NULL;
+  if (frames < 1)
+    return NULL;
+  size = ring_size((uint32_t)frames);
+  fd = ring_fd(name, O_RDWR | O_CREAT, shared);
+  if (fd < 0) {
+    fprintf(stderr, ">> Could not open %s\n", name);
+    return NULL;
+  }
+  if (!ring_lock(fd)) {
+    fprintf(stderr, ">> %s is being written by another process\n", name);
+    close(fd);
+    return NULL;
+  }
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size == size &&
+      (r = ring_map(fd, size, 1)) &&
+      !(ring_valid(r->header, size) &&
+        r->header->capacity == (uint32_t)frames)) {
+    ring_unmap(r);
+    r = NULL;
+  }
+  if (r) {
+    r->capacity = (uint32_t)frames;
+    r->next = atomic_load(&r->header->committed);
+    return r;
+  }
+  if (fstat(fd, &st) != 0 || st.st_size != 0) {
+    old = fd;
+    if (shared) {
+      shm_unlink(name);
+      fd = ring_fd(name, O_RDWR | O_CREAT | O_EXCL, shared);
+    } else if ((tmp = malloc(strlen(name) + 24))) {
+      sprintf(tmp, "%s.%ld", name, (long)getpid());
+      fd = ring_fd(tmp, O_RDWR | O_CREAT | O_EXCL, shared);
+    } else {
+      fd = -1;
+    }
+    if (fd < 0 || !ring_lock(fd)) {
+      fprintf(stderr, ">> Could not replace %s\n", name);
+      goto fail;
+    }
+  }
+  if (ring_alloc(fd, size) != 0 || !(r = ring_map(fd, size, 1))) {
+    fprintf(stderr, ">> Could not allocate %s\n", name);
+    goto fail;
+  }
+  // the magic goes last: a ring half initialized is started anew
+  r->capacity = (uint32_t)frames;
+  r->header->version = MTX_RING_VERSION;
+  r->header->pixels = MTX_PIXELS;
+  r->header->capacity = r->capacity;
+  r->header->record_size = sizeof(mtx_record_t);
+  atomic_store_explicit(&r->header->committed, 0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  r->header->magic = MTX_RING_MAGIC;
+  if (tmp && rename(tmp, name) != 0) {
+    fprintf(stderr, ">> Could not replace %s\n", name);
+    ring_unmap(r);
+    r = NULL;
+    goto fail;
+  }
+  if (old >= 0)
+    close(old);
+  free(tmp);
+  return r;
+fail:
+  if (fd >= 0) {
+    close(fd);
+    if (tmp)
+      unlink(tmp);
+  }
+  if (old >= 0)
+    close(old);
+  free(tmp);
+  return NULL;
+}
+
+static mightex_ring_t *ring_reader(const char *name, int shared) {
+  int fd;
+  struct stat st;
+  mightex_ring_t *r = NULL;
+  fd = ring_fd(name, O_RDONLY, shared);
+  if (fd < 0) {
+    fprintf(stderr, ">> Could not open %s\n", name);
+    return NULL;
+  }
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(mtx_ring_header_t))
+    r = ring_map(fd, st.st_size, 0);
+  // the mapping stays valid without the descriptor
+  close(fd);
+  if (!r || !ring_valid(r->header, r->size)) {
+    fprintf(stderr, ">> %s is not a frame ring\n", name);
+    if (r)
+      ring_unmap(r);
+    return NULL;
+  }
+  r->fd = -1;
+  r->capacity = r->header->capacity;
+  return r;
+}
+#endif
+
+// Make r (opened for writing, or NULL) the ring *slot of m
+static mtx_result_t ring_attach(mightex_t *m, mightex_ring_t **slot,
+                                mightex_ring_t *r) {
+#ifdef MTX_RINGS
+  if (m->stream || (r && !r->writer))
+    return MTX_FAIL;
+  if (r)
+    memcpy(r->header->serial_no, m->device_info.di.serial_no, STRING_LENGTH);
+  *slot = r;
+  return MTX_OK;
+#else
+  return r ? MTX_FAIL : MTX_OK;
+#endif
+}
+
+// Frame buffers
+//
+// A read claims a free buffer of the pool and the transfer fills it in place;
+// the buffer then becomes the current one, replacing the previous, which goes
+// back to the pool once no handle holds it. The pool only grows: buffers are
+// allocated when all are in use, which does not happen in steady state unless
+// the application holds frames. With mightex_set_buffer_pool() instead, the
+// buffers are carved once out of the caller's region and the pool is fixed.
+
+static void buf_free(mtx_buf_t *b) {
+  if (!b->external)
+    free(b->view);
+  free(b);
+}
+
+static int buf_refs(mtx_buf_t *b) {
+#ifdef MTX_THREADS
+  return atomic_load_explicit(&b->refs, memory_order_acquire);
+#else
+  return b->refs;
+#endif
+}
+
+static void buf_ref(mtx_buf_t *b) {
+#ifdef MTX_THREADS
+  atomic_fetch_add_explicit(&b->refs, 1, memory_order_relaxed);
+#else
+  b->refs++;
+#endif
+}
+
+static void buf_unref(mtx_buf_t *b) {
+#ifdef MTX_THREADS
+  if (atomic_fetch_sub_explicit(&b->refs, 1, memory_order_acq_rel) == 1)
+    buf_free(b);
+#else
+  if (--b->refs == 0)
+    buf_free(b);
+#endif
+}
+
+// Take a buffer with no reference other than the pool's
+static int buf_claim(mtx_buf_t *b) {
+#ifdef MTX_THREADS
+  int one = 1;
+  return atomic_compare_exchange_strong_explicit(
+      &b->refs, &one, 2, memory_order_acquire, memory_order_relaxed);
+#else
+  if (b->refs != 1)
+    return 0;
+  b->refs = 2;
+  return 1;
+#endif
+}
+
+// Add a buffer for n frames to the pool, referenced by the pool only. Frames
+// and view are at mem, if given, else allocated with the buffer.
+static mtx_buf_t *pool_link(mightex_t *m, int n, BYTE *mem) {
+  int i;
+  mtx_buf_t *b =
+      calloc(1, sizeof(mtx_buf_t) + (mem ? 0 : n * sizeof(ccd_frames_t)));
+  if (!b) {
+    fprintf(stderr, ">> Could not allocate a frame buffer\n");
+    return NULL;
+  }
+  if (mem) {
+    b->frames = (ccd_frames_t *)mem;
+    b->view = (uint16_t *)(mem + MTX_BUFFER_ROUND(n * sizeof(ccd_frames_t)));
+    b->external = 1;
+  } else {
+    b->frames = (ccd_frames_t *)(b + 1);
+  }
+  b->capacity = n;
+  for (i = 0; i < MTX_MAX_FRAMES; i++) {
+    b->handles[i].buf = b;
+    b->handles[i].index = i;
+  }
+#ifdef MTX_THREADS
+  atomic_init(&b->refs, 1);
+#else
+  b->refs = 1;
+#endif
+  b->next = m->pool;
+  m->pool = b;
+  return b;
+}
+
+// New buffer for n frames, unless the pool is fixed
+static mtx_buf_t *pool_add(mightex_t *m, int n) {
+  if (m->pool_frames) {
+    fprintf(stderr, ">> No free buffer in the frame buffer pool\n");
+    return NULL;
+  }
+  return pool_link(m, n, NULL);
+}
+
+// A free buffer for n frames, owned by the caller. Only called by the thread
+// reading frames, so that the pool list itself needs no locking.
+static mtx_buf_t *pool_get(mightex_t *m, int n) {
+  mtx_buf_t *b;
+  for (b = m->pool; b; b = b->next) {
+    if (b->capacity >= n && buf_claim(b))
+      break;
+  }
+  if (!b) {
+    b = pool_add(m, n);
+    if (!b)
+      return NULL;
+    buf_ref(b);
+  }
+  b->count = 0;
+  b->filtered = 0;
+  return b;
+}
+
+// Have at least n free buffers in the pool, so as not to allocate while
+// streaming: the current and the held ones do not count
+static mtx_result_t pool_reserve(mightex_t *m, int n) {
+  int avail = 0;
+  mtx_buf_t *b;
+  for (b = m->pool; b; b = b->next)
+    avail += buf_refs(b) == 1;
+  if (m->pool_frames && avail < n) {
+    fprintf(stderr,
+            ">> Buffer pool too small: %d free buffers needed, %d available\n",
+            n, avail);
+    return MTX_FAIL;
+  }
+  for (; avail < n; avail++) {
+    if (!pool_add(m, 1))
+      return MTX_FAIL;
+  }
+  return MTX_OK;
+}
+
+// Drop the pool's references: the buffers still held are freed on release
+static void pool_free(mightex_t *m) {
+  mtx_buf_t *b, *next;
+  if (m->cur)
+    buf_unref(m->cur);
+  m->cur = NULL;
+  for (b = m->pool; b; b = next) {
+    next = b->next;
+    buf_unref(b);
+  }
+  m->pool = NULL;
+}
+
+// Create the pool with an empty current frame
+static mtx_result_t pool_init(mightex_t *m) {
+  m->cur = pool_get(m, 1);
+  if (!m->cur)
+    return MTX_FAIL;
+  memset(m->cur->frames, 0, sizeof(ccd_frames_t));
+  m->cur->count = 1;
+  m->stale = 1;
+  return MTX_OK;
+}
+
+// The view of the current buffer, allocated on first use
+static uint16_t *frame_output(mightex_t *m) {
+  mtx_buf_t *b = m->cur;
+  if (!b->view) {
+    b->view = malloc(MTX_PIXELS * sizeof(uint16_t));
+    if (!b->view) {
+      fprintf(stderr, ">> Could not allocate a filtered view\n");
+      return NULL;
+    }
+    m->stale = 1;
+  }
+  return b->view;
+}
+
+// Pixels the filter and estimators work on: the raw frame itself without a
+// filter, unless a pipeline wrote the view, else the view
+static uint16_t *frame_view(mightex_t *m) {
+  uint16_t *view, *raw = ccd_pixels(&m->cur->frames[0]);
+  if (!m->filter && !m->cur->filtered)
+    return raw;
+  view = frame_output(m);
+  return view ? view : raw;
+}
+
+// Update the per-frame data of the i-th frame of the last read
+static void mightex_account_frame(mightex_t *m, int i) {
+  m->cur->dark_means[i] = frame_dark_mean(&m->cur->frames[i]);
+  m->cur->missed[i] = frame_missed_triggers(m, &m->cur->frames[i],
+                                            i == 0 ? m->cur->dropped : 0);
+}
+
+// Record and publish the n frames read into b
+static void mightex_record_frames(mightex_t *m, mtx_buf_t *b, int n) {
+#ifdef MTX_RINGS
+  int i;
+  for (i = 0; i < n; i++) {
+    if (m->recorder)
+      ring_write(m->recorder, &b->frames[i]);
+    if (m->publisher)
+      ring_write(m->publisher, &b->frames[i]);
+  }
+#endif
+}
+
+// Make the n frames read into b current, handing over the caller's reference.
+// The filtered view is only copied when needed. Frames of the acquisition 
+// thread have been recorded on arrival.
+static void mightex_store_frames(mightex_t *m, mtx_buf_t *b, int n) {
+  int i;
+  if (!m->queue) {
+    mightex_record_frames(m, b, n);
+    b->gaps = m->gaps;
+    b->dropped = 0;
+  }
+  if (m->cur)
+    buf_unref(m->cur);
+  m->cur = b;
+  b->count = n;
+  // a reconnected camera counts triggers from scratch
+  if (b->gaps != m->trigger_gaps) {
+    m->trigger_gaps = b->gaps;
+    m->trigger_seen = 0;
+  }
+  for (i = 0; i < n; i++)
+    mightex_account_frame(m, i);
+  m->dark_mean = b->dark_means[0];
+  m->frame_count = n;
+  if (!m->queue)
+    auto_exposure_update(m, &b->frames[0], b->dark_means[0]);
+  m->stale = 1;
+}
+
+// Streaming
+//
+// Each slot of the ring keeps a frame request and a frame transfer in flight.
+// libusb completes transfers on the same endpoint in submission order, so
+// frames are delivered in the order the camera sends them.
+
+static void LIBUSB_CALL stream_xfer_cb(struct libusb_transfer *t);
+static void LIBUSB_CALL stream_cmd_cb(struct libusb_transfer *t);
+
+static int stream_submit(mtx_slot_t *s) {
+  int rc;
+  s->resubmit = 0;
+  rc = libusb_submit_transfer(s->cmd);
+  if (rc != LIBUSB_SUCCESS)
+    return rc;
+  s->cmd_busy = 1;
+  rc = libusb_submit_transfer(s->xfer);
+  if (rc != LIBUSB_SUCCESS)
+    return rc;
+  s->xfer_busy = 1;
+  return LIBUSB_SUCCESS;
+}
+
+// Hand the buffer of slot s over and give the slot a fresh one for its next
+// transfer: with no buffer left, the frame is dropped and the slot keeps it
+static void stream_deliver(mightex_t *m, mtx_slot_t *s) {
+  mtx_buf_t *b = s->buf;
+#ifdef MTX_THREADS
+  // acquisition thread: hand the frame over to the consumer
+  if (m->queue) {
+    mtx_queue_t *q = m->queue;
+    unsigned long head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    m->stream_count++;
+    // recorded, and checked for exposure, even if the queue drops it
+    mightex_record_frames(m, b, 1);
+    auto_exposure_update(m, &b->frames[0], frame_dark_mean(&b->frames[0]));
+    if (head - atomic_load_explicit(&q->tail, memory_order_acquire) > q->mask ||
+        !(s->buf = pool_get(m, 1))) {
+      s->buf = b;
+      atomic_fetch_add_explicit(&q->dropped, 1, memory_order_relaxed);
+      // already counted by mightex_dropped_frames, not as missed triggers
+      if (b->frames[0].frame.trigger_occurred)
+        q->dropped_triggered++;
+      return;
+    }
+    if (s->xfer)
+      s->xfer->buffer = s->buf->frames[0].buf;
+    b->count = 1;
+    b->gaps = m->gaps;
+    b->dropped = q->dropped_triggered;
+    q->dropped_triggered = 0;
+    q->slots[head & q->mask] = b;
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return;
+  }
+#endif
+  m->stream_count++;
+  s->buf = pool_get(m, 1);
+  if (!s->buf) {
+    s->buf = b;
+    return;
+  }
+  if (s->xfer)
+    s->xfer->buffer = s->buf->frames[0].buf;
+  mightex_store_frames(m, b, 1);
+  if (m->stream_cb)
+    m->stream_cb(m, m->stream_ud);
+}
+
+static void LIBUSB_CALL stream_xfer_cb(struct libusb_transfer *t) {
+  mtx_slot_t *s = (mtx_slot_t *)t->user_data;
+  mightex_t *m = s->m;
+  s->xfer_busy = 0;
+  switch (t->status) {
+  case LIBUSB_TRANSFER_COMPLETED:
+    s->errors = 0;
+    if (t->actual_length == sizeof(ccd_frames_t))
+      stream_deliver(m, s);
+    break;
+  case LIBUSB_TRANSFER_TIMED_OUT:
+    break;
+  case LIBUSB_TRANSFER_NO_DEVICE:
+    m->lost = 1;
+    return;
+  case LIBUSB_TRANSFER_CANCELLED:
+    return;
+  default:
+    if (!m->stream_active)
+      return;
+    fprintf(stderr, ">> Stream transfer failed (%d)\n", t->status);
+    // let the ring drain, and reconnection resubmit it
+    if (++s->errors > MTX_STREAM_RETRIES) {
+      m->lost = 1;
+      return;
+    }
+    break;
+  }
+  if (!m->stream_active || m->lost)
+    return;
+  // the request for this slot may still be waiting for its own callback
+  if (s->cmd_busy)
+    s->resubmit = 1;
+  else if (stream_submit(s) != LIBUSB_SUCCESS)
+    fprintf(stderr, ">> Could not resubmit stream transfer\n");
+}
+
+static void LIBUSB_CALL stream_cmd_cb(struct libusb_transfer *t) {
+  mtx_slot_t *s = (mtx_slot_t *)t->user_data;
+  s->cmd_busy = 0;
+  if (s->resubmit && s->m->stream_active && !s->m->lost &&
+      stream_submit(s) != LIBUSB_SUCCESS)
+    fprintf(stderr, ">> Could not resubmit stream transfer\n");
+}
+
+static int stream_busy(mightex_t *m) {
+  int i, busy = 0;
+  for (i = 0; i < m->stream_depth; i++)
+    busy += m->stream[i].cmd_busy + m->stream[i].xfer_busy;
+  return busy;
+}
+
+static void stream_free(mightex_t *m) {
+  int i;
+  for (i = 0; i < m->stream_depth; i++) {
+    libusb_free_transfer(m->stream[i].cmd);
+    libusb_free_transfer(m->stream[i].xfer);
+    if (m->stream[i].buf)
+      buf_unref(m->stream[i].buf);
+  }
+  free(m->stream);
+  m->stream = NULL;
+  m->stream_depth = 0;
+}
+
+// Simulated counterpart of libusb_handle_events_timeout_completed(): complete
+// the due slots in order, waiting at most timeout_ms for the first one
+static int sim_stream_poll(mightex_t *m, int timeout_ms) {
+  mtx_sim_t *sim = m->sim;
+  double deadline = mtx_now_us() + timeout_ms * 1000.0;
+  double done, now;
+  int n = 0;
+  mtx_slot_t *s = &m->stream[m->stream_count % m->stream_depth];
+
+  for (;;) {
+    SIM_LOCK(sim);
+    now = mtx_now_us();
+    if (sim->unplugged_until > 0) {
+      // in-flight transfers fail: wait for the device to come back
+      done = sim->unplugged_until < deadline ? sim->unplugged_until : deadline;
+      SIM_UNLOCK(sim);
+      m->lost = 1;
+      if (n == 0)
+        mtx_sleep_us(done - now);
+      return n;
+    }
+    sim_available(sim, now);
+    // with a single slot the request cannot be sent before the frame arrives
+    done = sim->last_done + MTX_SIM_XFER_US +
+           (m->stream_depth > 1 ? 0 : 2 * MTX_SIM_LATENCY_US);
+    if (done < sim_next_ready(sim))
+      done = sim_next_ready(sim);
+    if (done > now) {
+      SIM_UNLOCK(sim);
+      if (n > 0)
+        return n;
+      if (done > deadline) {
+        mtx_sleep_us(deadline - now);
+        return 0;
+      }
+      mtx_sleep_us(done - now);
+      continue;
+    }
+    sim->last_done = done;
+    sim_fill_frame(sim, &s->buf->frames[0]);
+    SIM_UNLOCK(sim);
+    stream_deliver(m, s);
+    s = &m->stream[m->stream_count % m->stream_depth];
+    // at most one round of the ring per call, as with libusb
+    if (++n == m->stream_depth || !m->stream_active)
+      return n;
+  }
+}
+
+static void mightex_service(mightex_t *m);
+
+#ifdef MTX_THREADS
+static void *acquisition_loop(void *arg) {
+  mightex_t *m = (mightex_t *)arg;
+  while (atomic_load(&m->queue->running)) {
+    if (mightex_stream_poll(m, 100) < 0) {
+      fprintf(stderr, ">> Acquisition stream interrupted\n");
+      break;
+    }
+  }
+  return NULL;
+}
+#endif
+
+static mtx_result_t mightex_send(mightex_t *m, BYTE *const buf, int len) {
+  int rc;
+  rc = mightex_bulk(m, MTX_EP_CMD, buf, len, NULL);
+  if (rc != LIBUSB_SUCCESS) {
+    fprintf(stderr, "Error on send: %s\n", libusb_error_name(rc));
+    return MTX_FAIL;
+  }
+  return MTX_OK;
+}
+
+static mtx_result_t mightex_receive(mightex_t *m, BYTE *const buf, int len) {
+  int rc;
+  rc = mightex_bulk(m, MTX_EP_REPLY, buf, len, NULL);
+  if (rc != LIBUSB_SUCCESS) {
+    fprintf(stderr, "Error on receive: %s\n", libusb_error_name(rc));
+    return MTX_FAIL;
+  }
+  return (mtx_result_t)buf[0];
+}
+
+static mtx_result_t mightex_get_version(mightex_t *m) {
+  int rc;
+  device_version_t *dv = &m->device_version;
+  // request
+  memset(dv, 0, sizeof(device_info_t));
+  dv->buf[0] = MTX_CMD_FIRMWARE;
+  dv->buf[1] = 0x01;
+  dv->buf[2] = 0x02;
+  CAM_LOCK(m);
+  rc = mightex_send(m, dv->buf, 3);
+  if (rc != MTX_OK) {
+    CAM_UNLOCK(m);
+    return MTX_FAIL;
+  }
+  // reply
+  memset(dv, 0, sizeof(device_info_t));
+  rc = mightex_receive(m, dv->buf, sizeof(dv->version));
+  CAM_UNLOCK(m);
+  snprintf(m->version, sizeof(m->version), "%d.%d.%d", dv->version.major,
+           dv->version.minor, dv->version.rev);
+  return rc;
+}
+
+static mtx_result_t mightex_get_info(mightex_t *m) {
+  int rc;
+  device_info_t *di = &m->device_info;
+  // request
+  memset(di, 0, sizeof(device_info_t));
+  di->buf[0] = MTX_CMD_INFO;
+  di->buf[1] = 0x01;
+  di->buf[2] = 0x00;
+  CAM_LOCK(m);
+  rc = mightex_send(m, di->buf, 3);
+  if (rc != MTX_OK) {
+    CAM_UNLOCK(m);
+    return MTX_FAIL;
+  }
+  // reply
+  memset(di, 0, sizeof(device_info_t));
+  rc = mightex_receive(m, di->buf, sizeof(device_info_t));
+  CAM_UNLOCK(m);
+  return rc;
+}
+
+// The mode command alone: the trigger bookkeeping belongs to the consumer
+static mtx_result_t mightex_send_mode(mightex_t *m, mtx_mode_t mode) {
+  BYTE buf[3] = {MTX_CMD_MODE, 0x01, (BYTE)mode};
+  return mightex_send(m, buf, sizeof(buf));
+}
+
+static mtx_result_t mightex_prepare_buffered_data(mightex_t *m, BYTE n) {
+  BYTE buf[3];
+  buf[0] = MTX_CMD_GETBUFFEREDDATA;
+  buf[1] = 0x01;
+  buf[2] = n;
+  return mightex_send(m, buf, sizeof(buf));
+}
+
+// Add the time elapsed since t, in ms, to *acc; return the current time
+static double mtx_lap_ms(double t, double *acc) {
+  double now = mtx_now_us();
+  if (acc)
+    *acc += (now - t) / 1000.0;
+  return now;
+}
+
+// Open cache
+//
+// A flat file of mtx_cache_entry_t records, one per camera, in the directory
+// given by the MIGHTEX_CACHE_DIR environment variable, or in the user's cache
+// directory. A camera is trusted to be the cached one if it sits on the same
+// USB port, so swapping cameras between ports requires opening them once
+// without MTX_OPEN_CACHE. The file is replaced as a whole, by renaming a new
+// one over it, so that readers never see it half written.
+
+// Path of the cache file, or 0 with no directory for it
+static int cache_path(char *path, size_t len) {
+  const char *dir = getenv("MIGHTEX_CACHE_DIR");
+#ifdef _WIN32
+  if (!dir)
+    dir = getenv("LOCALAPPDATA");
+  if (!dir)
+    dir = getenv("TEMP");
+  if (!dir)
+    return 0;
+  snprintf(path, len, "%s\\%s", dir, MTX_CACHE_FILE);
+#else
+  const char *home = getenv("HOME");
+  char cache[512];
+  if (!dir)
+    dir = getenv("XDG_CACHE_HOME");
+  if (!dir) {
+    if (!home || !*home)
+      return 0;
+    // ~/.cache may not exist yet
+    snprintf(cache, sizeof(cache), "%s/.cache", home);
+    if (mkdir(cache, 0700) != 0 && errno != EEXIST)
+      return 0;
+    dir = cache;
+  }
+  snprintf(path, len, "%s/%s", dir, MTX_CACHE_FILE);
+#endif
+  return 1;
+}
+
+static int cache_load(mtx_cache_entry_t **entries) {
+  char path[1024];
+  FILE *f;
+  long size;
+  int n = 0;
+  *entries = NULL;
+  if (!cache_path(path, sizeof(path)))
+    return 0;
+  f = fopen(path, "rb");
+  if (!f)
+    return 0;
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  rewind(f);
+  if (size > 0 && (*entries = malloc(size)) != NULL)
+    n = (int)fread(*entries, sizeof(mtx_cache_entry_t),
+                   size / sizeof(mtx_cache_entry_t), f);
+  fclose(f);
+  return n;
+}
+
+static void cache_key(libusb_device *dev, mtx_cache_entry_t *e) {
+  int n = libusb_get_port_numbers(dev, e->ports, MTX_MAX_PORTS);
+  e->bus = libusb_get_bus_number(dev);
+  e->n_ports = n > 0 ? (uint8_t)n : 0;
+}
+
+static int cache_same_port(const mtx_cache_entry_t *a,
+                           const mtx_cache_entry_t *b) {
+  return a->bus == b->bus && a->n_ports == b->n_ports &&
+         memcmp(a->ports, b->ports, a->n_ports) == 0;
+}
+
+static const mtx_cache_entry_t *cache_find(const mtx_cache_entry_t *entries,
+                                           int n, libusb_device *dev,
+                                           const char *serial) {
+  int i;
+  mtx_cache_entry_t key;
+  cache_key(dev, &key);
+  if (key.n_ports == 0)
+    return NULL;
+  for (i = 0; i < n; i++) {
+    if (entries[i].magic != MTX_CACHE_MAGIC ||
+        !cache_same_port(&entries[i], &key))
+      continue;
+    if (!serial || strncmp((const char *)entries[i].device_info.di.serial_no,
+                           serial, STRING_LENGTH) == 0)
+      return &entries[i];
+  }
+  return NULL;
+}
+
+// Rewrite the cache, replacing any record with the same serial or port
+static void cache_store(const mtx_cache_entry_t *entries, int n,
+                        mightex_t *m) {
+  char path[1024], tmp[1040];
+  FILE *f;
+  int i, ok;
+  mtx_cache_entry_t e;
+
+  memset(&e, 0, sizeof(e));
+  e.magic = MTX_CACHE_MAGIC;
+  cache_key(m->dev, &e);
+  memcpy(e.manufacturer, m->manufacturer, sizeof(e.manufacturer) - 1);
+  memcpy(e.product, m->product, sizeof(e.product) - 1);
+  memcpy(e.version, m->version, sizeof(e.version));
+  e.device_info = m->device_info;
+  e.device_version = m->device_version;
+  if (!cache_path(path, sizeof(path)))
+    return;
+  // a new file, never one that is already there
+#ifdef _WIN32
+  snprintf(tmp, sizeof(tmp), "%s.%lu", path, GetCurrentProcessId());
+#else
+  snprintf(tmp, sizeof(tmp), "%s.%ld", path, (long)getpid());
+#endif
+  f = fopen(tmp, "wbx");
+  if (!f) {
+    fprintf(stderr, ">> Could not write open cache %s\n", tmp);
+    return;
+  }
+  for (i = 0; i < n; i++) {
+    if (cache_same_port(&entries[i], &e) ||
+        memcmp(entries[i].device_info.di.serial_no, e.device_info.di.serial_no,
+               STRING_LENGTH) == 0)
+      continue;
+    fwrite(&entries[i], sizeof(e), 1, f);
+  }
+  ok = fwrite(&e, sizeof(e), 1, f) == 1;
+  ok = fclose(f) == 0 && ok;
+#ifdef _WIN32
+  ok = ok && MoveFileExA(tmp, path, MOVEFILE_REPLACE_EXISTING);
+#else
+  ok = ok && rename(tmp, path) == 0;
+#endif
+  if (!ok) {
+    fprintf(stderr, ">> Could not write open cache %s\n", path);
+    remove(tmp);
+  }
+}
+
+// The camera lock is recursive: reconnection sends commands while holding it
+static void mightex_lock_init(mightex_t *m) {
+#ifdef MTX_THREADS
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&m->lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+#endif
+}
+
+static mightex_t *mightex_alloc(void) {
+  mightex_t *m = calloc(1, sizeof(mightex_t));
+  if (!m)
+    return NULL;
+  m->timeout = MTX_TIMEOUT;
+  m->dark_mean = 0;
+  m->desc = malloc(sizeof(*m->desc));
+  m->filter = filter_dark;
+  m->estimator = estimator_center;
+  m->multi_estimator = estimator_peaks;
+  if (pool_init(m) != MTX_OK) {
+    free(m->desc);
+    free(m);
+    return NULL;
+  }
+  mightex_lock_init(m);
+  snprintf(m->sw_version, sizeof(m->sw_version), "%s %s %s", GIT_COMMIT_HASH,
+           CMAKE_PLATFORM, CMAKE_BUILD_TYPE);
+  return m;
+}
+
+static int mightex_is_camera(libusb_device *dev,
+                             struct libusb_device_descriptor *desc) {
+  int rc = libusb_get_device_descriptor(dev, desc);
+  if (rc < 0) {
+    fprintf(stderr, ">>> FATAL: Failed to get device descriptor (%s).",
+            libusb_error_name(rc));
+    return 0;
+  }
+  return desc->idVendor == USB_IDVENDOR && desc->idProduct == USB_IDPRODUCT;
+}
+
+static void mightex_reset_device(mightex_t *m, mightex_open_times_t *times) {
+  double t = mtx_now_us();
+  int rc = libusb_reset_device(m->handle);
+  if (rc != LIBUSB_SUCCESS)
+    fprintf(stderr, ">> Could not reset device (%s)\n", libusb_error_name(rc));
+  mtx_lap_ms(t, times ? &times->reset : NULL);
+}
+
+// Open and claim dev, then query strings, firmware version and device info,
+// unless a cache entry ce for it is available
+static mtx_result_t mightex_open_device(mightex_t *m, libusb_device *dev,
+                                        unsigned int flags,
+                                        mightex_open_times_t *times,
+                                        const mtx_cache_entry_t *ce) {
+  int rc;
+  double t = mtx_now_us();
+
+  rc = libusb_open(dev, &m->handle);
+  if (rc != LIBUSB_SUCCESS) {
+    fprintf(stderr, ">>> FATAL: Could not open device (%s)\n",
+            libusb_error_name(rc));
+#ifdef _WIN32
+    fprintf(stderr,
+            "    Perhaps WinUSB driver has not been installed and selected?\n");
+#endif
+    m->handle = NULL;
+    return MTX_FAIL;
+  }
+
+  rc = libusb_set_auto_detach_kernel_driver(m->handle, 1);
+  if (rc != LIBUSB_SUCCESS && rc != LIBUSB_ERROR_NOT_SUPPORTED)
+    fprintf(stderr, ">> Could not set auto-detach (%s)\n",
+            libusb_error_name(rc));
+
+  rc = libusb_claim_interface(m->handle, 0);
+  if (rc != LIBUSB_SUCCESS) {
+    fprintf(stderr, ">>> FATAL: Could not claim device interface (%s)\n",
+            libusb_error_name(rc));
+    libusb_close(m->handle);
+    m->handle = NULL;
+    return MTX_FAIL;
+  }
+  m->dev = libusb_ref_device(dev);
+  t = mtx_lap_ms(t, times ? &times->open : NULL);
+
+  // reset only once claimed, so that cameras in use elsewhere are left alone
+  if (!(flags & MTX_OPEN_NO_RESET))
+    mightex_reset_device(m, times);
+  t = mtx_now_us();
+
+  if (ce) {
+    memcpy(m->manufacturer, ce->manufacturer, sizeof(ce->manufacturer));
+    memcpy(m->product, ce->product, sizeof(ce->product));
+    m->device_version = ce->device_version;
+    memcpy(m->version, ce->version, sizeof(m->version));
+    m->device_info = ce->device_info;
+    mtx_lap_ms(t, times ? &times->descriptors : NULL);
+    fprintf(stderr, "> Found device: %s - %s (cached)\n", m->manufacturer,
+            m->product);
+    return MTX_OK;
+  }
+
+  rc = libusb_get_string_descriptor_ascii(m->handle, m->desc->iManufacturer,
+                                          m->manufacturer,
+                                          sizeof(m->manufacturer));
+  if (rc <= 0)
+    fprintf(stderr, ">> Could nor read device manufacturer (%s)\n",
+            libusb_error_name(rc));
+
+  rc = libusb_get_string_descriptor_ascii(m->handle, m->desc->iProduct,
+                                          m->product, sizeof(m->product));
+  if (rc <= 0)
+    fprintf(stderr, ">> Could nor read device name (%s)\n",
+            libusb_error_name(rc));
+  t = mtx_lap_ms(t, times ? &times->descriptors : NULL);
+
+  fprintf(stderr, "> Found device: %s - %s\n", m->manufacturer, m->product);
+
+  mightex_get_version(m);
+  fprintf(stderr, "> Version: %s\n", mightex_version(m));
+
+  mightex_get_info(m);
+  fprintf(stderr, "> SerialNo.: %s\n", mightex_serial_no(m));
+  mtx_lap_ms(t, times ? &times->info : NULL);
+  return MTX_OK;
+}
+
+static void mightex_close_device(mightex_t *m) {
+  int rc;
+  if (m->handle) {
+    rc = libusb_release_interface(m->handle, 0);
+    if (rc != LIBUSB_SUCCESS)
+      fprintf(stderr, ">> Could not release interface (%s)\n",
+              libusb_error_name(rc));
+    libusb_close(m->handle);
+    m->handle = NULL;
+  }
+  if (m->dev) {
+    libusb_unref_device(m->dev);
+    m->dev = NULL;
+  }
+}
+
+// Shared context
+//
+// Cameras opened with mightex_open_serial() and mightex_open_all() live on a
+// single libusb context. While any of them runs the acquisition thread, a
+// single thread handles the events of all of them.
+
+static libusb_context *shared_ctx_retain(void) {
+  int rc;
+  SHARED_LOCK();
+  if (mtx_shared.refs == 0) {
+    rc = libusb_init(&mtx_shared.ctx);
+    if (rc < 0) {
+      SHARED_UNLOCK();
+      return NULL;
+    }
+    rc = libusb_set_option(mtx_shared.ctx, LIBUSB_OPTION_LOG_LEVEL,
+                           LIBUSB_LOG_LEVEL_NONE);
+    if (rc != LIBUSB_SUCCESS)
+      fprintf(stderr, "> Could not set log level (%s).\n",
+              libusb_error_name(rc));
+  }
+  mtx_shared.refs++;
+  SHARED_UNLOCK();
+  return mtx_shared.ctx;
+}
+
+static void shared_ctx_release(void) {
+  SHARED_LOCK();
+  if (--mtx_shared.refs == 0) {
+    libusb_exit(mtx_shared.ctx);
+    mtx_shared.ctx = NULL;
+  }
+  SHARED_UNLOCK();
+}
+
+#ifdef MTX_THREADS
+static void *shared_event_loop(void *arg) {
+  int i;
+  struct timeval tv = {0, 100000};
+  while (atomic_load(&mtx_shared.running)) {
+    libusb_handle_events_timeout_completed(mtx_shared.ctx, &tv, NULL);
+    pthread_mutex_lock(&mtx_shared.cams_lock);
+    for (i = 0; i < MTX_MAX_SHARED; i++) {
+      if (mtx_shared.cams[i]) {
+        mightex_service(mtx_shared.cams[i]);
+        auto_exposure_apply(mtx_shared.cams[i]);
+      }
+    }
+    pthread_mutex_unlock(&mtx_shared.cams_lock);
+  }
+  return NULL;
+}
+
+static void shared_cams_set(mightex_t *from, mightex_t *to) {
+  int i;
+  pthread_mutex_lock(&mtx_shared.cams_lock);
+  for (i = 0; i < MTX_MAX_SHARED; i++) {
+    if (mtx_shared.cams[i] == from) {
+      mtx_shared.cams[i] = to;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&mtx_shared.cams_lock);
+}
+
+static mtx_result_t shared_events_retain(mightex_t *m) {
+  mtx_result_t result = MTX_OK;
+  SHARED_LOCK();
+  if (mtx_shared.streams == MTX_MAX_SHARED) {
+    SHARED_UNLOCK();
+    return MTX_FAIL;
+  }
+  shared_cams_set(NULL, m);
+  if (mtx_shared.streams++ == 0) {
+    atomic_store(&mtx_shared.running, 1);
+    if (pthread_create(&mtx_shared.thread, NULL, shared_event_loop, NULL)) {
+      shared_cams_set(m, NULL);
+      mtx_shared.streams = 0;
+      result = MTX_FAIL;
+    }
+  }
+  SHARED_UNLOCK();
+  return result;
+}
+
+// Stop servicing m: once this returns, the event thread no longer touches it
+static void shared_events_forget(mightex_t *m) { shared_cams_set(m, NULL); }
+
+static void shared_events_release(void) {
+  SHARED_LOCK();
+  if (--mtx_shared.streams == 0) {
+    atomic_store(&mtx_shared.running, 0);
+    pthread_join(mtx_shared.thread, NULL);
+  }
+  SHARED_UNLOCK();
+}
+#endif
+
+// Open dev on the shared context, if it is a camera
+static mightex_t *mightex_open_shared(libusb_device *dev, unsigned int flags,
+                                      mightex_open_times_t *times,
+                                      const mtx_cache_entry_t *ce) {
+  mightex_t *m = mightex_alloc();
+  if (!m)
+    return NULL;
+  m->ctx = shared_ctx_retain();
+  m->shared = 1;
+  if (!m->ctx || !mightex_is_camera(dev, m->desc) ||
+      mightex_open_device(m, dev, flags, times, ce) != MTX_OK) {
+    mightex_close(m);
+    return NULL;
+  }
+  return m;
+}
+
+// Calibration
+//
+// Tables are captured at the current exposure time, averaging frames read one
+// at a time, and applied to the frames taken with the same exposure time.
+
+static mtx_calib_t *calib_find(mightex_t *m, uint16_t exptime) {
+  int i;
+  for (i = 0; i < m->n_calib; i++) {
+    if (m->calib[i].exptime == exptime)
+      return &m->calib[i];
+  }
+  return NULL;
+}
+
+// The tables for exptime, created if needed
+static mtx_calib_t *calib_slot(mightex_t *m, uint16_t exptime) {
+  mtx_calib_t *c = calib_find(m, exptime);
+  if (c)
+    return c;
+  if (!m->calib && !(m->calib = malloc(MTX_MAX_CALIB * sizeof(mtx_calib_t))))
+    return NULL;
+  if (m->n_calib == MTX_MAX_CALIB) {
+    fprintf(stderr, ">> Too many calibrated exposure times\n");
+    return NULL;
+  }
+  c = &m->calib[m->n_calib++];
+  c->exptime = exptime;
+  return c;
+}
+
+// Sum n frames taken at the current exposure time
+static mtx_result_t calib_capture(mightex_t *m, int n, uint32_t *sum) {
+  int i, got = 0, skipped = 0, ae = m->ae_enabled;
+  uint16_t units = exptime_units(m->exptime);
+
+  if (m->stream || m->queue || m->exptime <= 0 || n < 1 || n > 65536) {
+    fprintf(stderr, ">> Cannot calibrate: set the exposure time, do not "
+                    "stream, use 1 to 65536 frames\n");
+    return MTX_FAIL;
+  }
+  memset(sum, 0, MTX_PIXELS * sizeof(uint32_t));
+  m->ae_enabled = 0;
+  while (got < n) {
+    if (mightex_wait_frame(m, MTX_TIMEOUT + (int)m->exptime) <= 0 ||
+        mightex_read_frame(m) != MTX_OK)
+      break;
+    // skip the frames still exposed with a previous setting
+    if (m->cur->frames[0].frame.exposure_time != units) {
+      if (++skipped > 4 * MTX_MAX_FRAMES)
+        break;
+      continue;
+    }
+    for (i = 0; i < MTX_PIXELS; i++)
+      sum[i] += m->cur->frames[0].frame.image_data[i];
+    got++;
+  }
+  m->ae_enabled = ae;
+  if (got < n) {
+    fprintf(stderr, ">> Calibration capture failed after %d frames\n", got);
+    return MTX_FAIL;
+  }
+  return MTX_OK;
+}
+
+// Reconnection
+//
+// With auto-reconnect enabled, a camera that drops off the bus is marked as
+// lost. Hotplug callbacks (or, where not available, a periodic retry) trigger
+// mightex_reconnect(), always called outside of libusb callbacks: it reopens
+// the camera with the same serial number, restores exposure time and mode and
+// resubmits the stream ring into the same buffers. It may run on the
+// acquisition thread while another thread sends commands, so it holds the
+// camera lock, as every exchange with the camera does.
+
+static int LIBUSB_CALL hotplug_cb(libusb_context *ctx, libusb_device *dev,
+                                  libusb_hotplug_event event, void *ud) {
+  mightex_t *m = (mightex_t *)ud;
+  if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT && dev == m->dev)
+    m->lost = 1;
+  else if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED)
+    m->arrived = 1;
+  return 0;
+}
+
+// Reconnection proper, with the camera locked
+static mtx_result_t mightex_reopen(mightex_t *m) {
+  int i;
+  libusb_device **devs, **dev;
+  BYTE serial[STRING_LENGTH];
+
+  // never close the handle under transfers that have not completed yet
+  if (m->stream && stream_busy(m))
+    return MTX_FAIL;
+  memcpy(serial, m->device_info.di.serial_no, STRING_LENGTH);
+  if (m->sim) {
+    mightex_get_info(m);
+  } else {
+    mightex_close_device(m);
+    if (libusb_get_device_list(m->ctx, &devs) < 0)
+      return MTX_FAIL;
+    for (dev = devs; *dev && !m->handle; dev++) {
+      if (!mightex_is_camera(*dev, m->desc) ||
+          mightex_open_device(m, *dev, MTX_OPEN_DEFAULT, NULL, NULL) != MTX_OK)
+        continue;
+      if (memcmp(m->device_info.di.serial_no, serial, STRING_LENGTH) != 0)
+        mightex_close_device(m);
+    }
+    libusb_free_device_list(devs, 1);
+  }
+  if (memcmp(m->device_info.di.serial_no, serial, STRING_LENGTH) != 0) {
+    memcpy(m->device_info.di.serial_no, serial, STRING_LENGTH);
+    return MTX_FAIL;
+  }
+  if (m->exptime > 0)
+    mightex_set_exptime(m, m->exptime);
+  mightex_send_mode(m, m->mode);
+  m->lost = 0;
+  m->next_due = 0;
+  m->gaps++;
+  if (m->stream && m->stream_active) {
+    if (m->sim) {
+      m->sim->last_done = mtx_now_us();
+    } else {
+      for (i = 0; i < m->stream_depth; i++) {
+        m->stream[i].cmd->dev_handle = m->handle;
+        m->stream[i].xfer->dev_handle = m->handle;
+        m->stream[i].errors = 0;
+        if (stream_submit(&m->stream[i]) != LIBUSB_SUCCESS)
+          m->lost = 1;
+      }
+    }
+  }
+  fprintf(stderr, "> Reconnected to %.*s\n", STRING_LENGTH, serial);
+  return MTX_OK;
+}
+
+static mtx_result_t mightex_reconnect(mightex_t *m) {
+  mtx_result_t rc;
+  CAM_LOCK(m);
+  rc = mightex_reopen(m);
+  CAM_UNLOCK(m);
+  return rc;
+}
+
+// Housekeeping done between transfers: reconnect lost cameras
+static void mightex_service(mightex_t *m) {
+  double now;
+  if (!m->auto_reconnect)
+    return;
+  if (m->sim) {
+    switch (sim_hotplug(m->sim)) {
+    case 2:
+      m->arrived = 1;
+      // fall through
+    case 1:
+      m->lost = 1;
+    }
+  }
+  if (!m->lost)
+    return;
+  now = mtx_now_us();
+  if (m->arrived || now - m->last_attempt > MTX_RECONNECT_INTERVAL_US) {
+    m->arrived = 0;
+    m->last_attempt = now;
+    mightex_reconnect(m);
+  }
+}
+
+//   __  __      _   _               _
+//  |  \/  | ___| |_| |__   ___   __| |___
+//  | |\/| |/ _ \ __| '_ \ / _ \ / _` / __|
+//  | |  | |  __/ |_| | | | (_) | (_| \__ \
+//  |_|  |_|\___|\__|_| |_|\___/ \__,_|___/
+
+mightex_t *mightex_new() {
+  mightex_t *m = mightex_alloc();
+  int rc;
+  ssize_t cnt, i;
+  libusb_device **devs;
+
+  if (!m)
+    return NULL;
+  rc = libusb_init(&m->ctx);
+  if (rc < 0) {
+    pool_free(m);
+    free(m->desc);
+    free(m);
+    return NULL;
+  }
+
+  rc =
+      libusb_set_option(m->ctx, LIBUSB_OPTION_LOG_LEVEL, LIBUSB_LOG_LEVEL_NONE);
+  if (rc != LIBUSB_SUCCESS)
+    fprintf(stderr, "> Could not set log level (%s).\n", libusb_error_name(rc));
+
+  cnt = libusb_get_device_list(m->ctx, &devs);
+  if (cnt < 0) {
+    fprintf(stderr, "> No devices available.\n");
+    mightex_close(m);
+    return NULL;
+  }
+
+  for (i = 0; i < cnt; i++) {
+    if (mightex_is_camera(devs[i], m->desc)) {
+      mightex_open_device(m, devs[i], MTX_OPEN_DEFAULT, NULL, NULL);
+      break;
+    }
+  }
+  libusb_free_device_list(devs, 1);
+  if (m->handle == NULL) {
+    mightex_close(m);
+    m = NULL;
+  }
+  return m;
+}
+
+mightex_t *mightex_open(const char *serial, unsigned int flags,
+                        mightex_open_times_t *times) {
+  mightex_t *m = NULL;
+  libusb_device **devs, **dev;
+  libusb_context *ctx;
+  mtx_cache_entry_t *cache = NULL;
+  const mtx_cache_entry_t *ce;
+  int n_cache = 0;
+  double t0 = mtx_now_us();
+
+  if (times)
+    memset(times, 0, sizeof(*times));
+  ctx = shared_ctx_retain();
+  if (!ctx)
+    return NULL;
+  if (libusb_get_device_list(ctx, &devs) < 0) {
+    fprintf(stderr, "> No devices available.\n");
+    shared_ctx_release();
+    return NULL;
+  }
+  if (flags & MTX_OPEN_CACHE)
+    n_cache = cache_load(&cache);
+  mtx_lap_ms(t0, times ? &times->enumerate : NULL);
+
+  // fast path: a cached camera sitting on the same port
+  for (dev = devs; *dev && n_cache > 0; dev++) {
+    ce = cache_find(cache, n_cache, *dev, serial);
+    if (ce && (m = mightex_open_shared(*dev, flags, times, ce)) != NULL)
+      break;
+  }
+  // slow path: query each camera for its serial number, resetting only the
+  // one that matches
+  for (dev = devs; *dev && !m; dev++) {
+    m = mightex_open_shared(*dev, serial ? flags | MTX_OPEN_NO_RESET : flags,
+                            times, NULL);
+    if (m && serial &&
+        strncmp(mightex_serial_no(m), serial, STRING_LENGTH) != 0) {
+      mightex_close(m);
+      m = NULL;
+    }
+    if (m && serial && !(flags & MTX_OPEN_NO_RESET))
+      mightex_reset_device(m, times);
+    if (m && (flags & MTX_OPEN_CACHE))
+      cache_store(cache, n_cache, m);
+  }
+  libusb_free_device_list(devs, 1);
+  free(cache);
+  shared_ctx_release();
+  if (times)
+    times->total = (mtx_now_us() - t0) / 1000.0;
+  return m;
+}
+
+mightex_t *mightex_open_serial(const char *serial) {
+  return mightex_open(serial, MTX_OPEN_DEFAULT, NULL);
+}
+
+int mightex_open_all(mightex_t **list, int max) {
+  int n = 0;
+  libusb_device **devs, **dev;
+  libusb_context *ctx = shared_ctx_retain();
+
+  if (!ctx)
+    return 0;
+  if (libusb_get_device_list(ctx, &devs) < 0) {
+    fprintf(stderr, "> No devices available.\n");
+    shared_ctx_release();
+    return 0;
+  }
+  for (dev = devs; *dev && n < max; dev++) {
+    list[n] = mightex_open_shared(*dev, MTX_OPEN_DEFAULT, NULL, NULL);
+    if (list[n] != NULL)
+      n++;
+  }
+  libusb_free_device_list(devs, 1);
+  shared_ctx_release();
+  return n;
+}
+
+mightex_t *mightex_new_simulated() {
+  mightex_t *m = calloc(1, sizeof(mightex_t));
+  if (!m)
+    return NULL;
+  m->timeout = MTX_TIMEOUT;
+  m->filter = filter_dark;
+  m->estimator = estimator_center;
+  m->multi_estimator = estimator_peaks;
+  m->sim = sim_new();
+  if (!m->sim || pool_init(m) != MTX_OK) {
+    if (m->sim)
+      sim_free(m->sim);
+    pool_free(m);
+    free(m);
+    return NULL;
+  }
+  mightex_lock_init(m);
+  snprintf((char *)m->manufacturer, sizeof(m->manufacturer), "Mightex");
+  snprintf((char *)m->product, sizeof(m->product), "TCE-1304-U (simulated)");
+  mightex_get_version(m);
+  mightex_get_info(m);
+  return m;
+}
+
+void mightex_close(mightex_t *m) {
+  if (!m)
+    return;
+  if (m->queue)
+    mightex_acquisition_stop(m);
+  if (m->stream)
+    mightex_stream_stop(m);
+  free(m->calib);
+  pool_free(m);
+#ifdef MTX_THREADS
+  pthread_mutex_destroy(&m->lock);
+#endif
+  if (m->sim) {
+    sim_free(m->sim);
+    free(m);
+    return;
+  }
+  if (m->auto_reconnect > 1)
+    libusb_hotplug_deregister_callback(m->ctx, m->hotplug);
+  mightex_close_device(m);
+  if (m->shared)
+    shared_ctx_release();
+  else
+    libusb_exit(m->ctx);
+  free(m->desc);
+  free(m);
+}
+
+mtx_result_t mightex_set_mode(mightex_t *m, mtx_mode_t mode) {
+  CAM_LOCK(m);
+  if (mightex_send_mode(m, mode) != MTX_OK) {
+    CAM_UNLOCK(m);
+    return MTX_FAIL;
+  }
+  m->mode = mode;
+  CAM_UNLOCK(m);
+  m->trigger_seen = 0;
+  return MTX_OK;
+}
+
+// t is in ms
+mtx_result_t mightex_set_exptime(mightex_t *m, float t) {
+  BYTE buf[4];
+  uint16_t val = htons(exptime_units(t));
+  buf[0] = MTX_CMD_EXPTIME;
+  buf[1] = 0x02;
+  memcpy(buf + 2, &val, sizeof(val));
+  CAM_LOCK(m);
+  if (mightex_send(m, buf, sizeof(buf)) != MTX_OK) {
+    CAM_UNLOCK(m);
+    return MTX_FAIL;
+  }
+  m->exptime = t;
+  m->next_due = 0;
+  CAM_UNLOCK(m);
+  return MTX_OK;
+}
+
+int mightex_get_buffer_count(mightex_t *m) {
+  int rc;
+  BYTE buf[3] = {MTX_CMD_BUFFEREDFRAMES, 0x01, 0x00};
+  CAM_LOCK(m);
+  mightex_send(m, buf, 2);
+  rc = mightex_receive(m, buf, sizeof(buf));
+  CAM_UNLOCK(m);
+  if (rc <= 0)
+    return rc;
+  return (int)buf[2];
+}
+
+int mightex_wait_frame(mightex_t *m, int timeout_ms) {
+  int n, missed = 0;
+  double now = mtx_now_us();
+  double deadline = now + timeout_ms * 1000.0;
+  double period = m->exptime * 1000.0;
+  double expected, wake, poll = MTX_WAIT_POLL_US;
+
+  // frames come out on a grid of one exposure time: m->next_due is the next
+  // point on that grid, or 0 when its phase is still unknown
+  expected = m->next_due > 0 ? m->next_due : now;
+  for (;;) {
+    if (now < expected - MTX_WAIT_MARGIN_US) {
+      wake = expected - MTX_WAIT_MARGIN_US;
+      mtx_sleep_us((wake < deadline ? wake : deadline) - now);
+    } else {
+      mightex_service(m);
+      n = mightex_get_buffer_count(m);
+      if (n < 0)
+        return n;
+      if (n > 0) {
+        now = mtx_now_us();
+        // having seen the buffer go from empty to full locks the phase
+        if (missed)
+          m->next_due = now;
+        if (m->next_due > 0 && period > 0) {
+          while (m->next_due <= now)
+            m->next_due += period;
+        }
+        return n;
+      }
+      missed = 1;
+      // late: back off, so that waiting for a trigger does not hog the bus
+      if (mtx_now_us() > expected + period) {
+        poll *= 2;
+        if (poll > MTX_WAIT_MAX_POLL_US)
+          poll = MTX_WAIT_MAX_POLL_US;
+      }
+      mtx_sleep_us(poll);
+    }
+    now = mtx_now_us();
+    if (now >= deadline)
+      return 0;
+  }
+}
+
+mtx_result_t mightex_read_frame(mightex_t *m) {
+  int rc;
+  mtx_buf_t *b;
+  mightex_service(m);
+  b = pool_get(m, 1);
+  if (!b)
+    return MTX_FAIL;
+  CAM_LOCK(m);
+  mightex_prepare_buffered_data(m, 1);
+  rc = mightex_bulk(m, MTX_EP_FRAME, b->frames[0].buf, sizeof(ccd_frames_t),
+                    NULL);
+  CAM_UNLOCK(m);
+  if (rc != LIBUSB_SUCCESS) {
+    buf_unref(b);
+    return MTX_FAIL;
+  }
+  mightex_store_frames(m, b, 1);
+  auto_exposure_apply(m);
+  return MTX_OK;
+}
+
+mtx_result_t mightex_stream_start(mightex_t *m, int depth,
+                                  mightex_frame_cb_t *cb, void *ud) {
+  int i, rc;
+  mtx_slot_t *s;
+  if (m->stream || depth < 1)
+    return MTX_FAIL;
+  m->stream = calloc(depth, sizeof(mtx_slot_t));
+  if (!m->stream)
+    return MTX_FAIL;
+  m->stream_depth = depth;
+  // a buffer per slot and one to swap in
+  if (pool_reserve(m, depth + 1) != MTX_OK) {
+    stream_free(m);
+    return MTX_FAIL;
+  }
+  for (i = 0; i < depth; i++) {
+    m->stream[i].buf = pool_get(m, 1);
+    if (!m->stream[i].buf) {
+      stream_free(m);
+      return MTX_FAIL;
+    }
+  }
+  m->stream_count = 0;
+  m->stream_cb = cb;
+  m->stream_ud = ud;
+  m->stream_active = 1;
+  if (m->sim) {
+    m->sim->last_done = mtx_now_us();
+    return MTX_OK;
+  }
+  for (i = 0; i < depth; i++) {
+    s = &m->stream[i];
+    s->m = m;
+    s->cmd_buf[0] = MTX_CMD_GETBUFFEREDDATA;
+    s->cmd_buf[1] = 0x01;
+    s->cmd_buf[2] = 1;
+    s->cmd = libusb_alloc_transfer(0);
+    s->xfer = libusb_alloc_transfer(0);
+    if (!s->cmd || !s->xfer) {
+      m->stream_depth = i + 1;
+      mightex_stream_stop(m);
+      return MTX_FAIL;
+    }
+    libusb_fill_bulk_transfer(s->cmd, m->handle, MTX_EP_CMD, s->cmd_buf,
+                              sizeof(s->cmd_buf), stream_cmd_cb, s, m->timeout);
+    libusb_fill_bulk_transfer(s->xfer, m->handle, MTX_EP_FRAME,
+                              s->buf->frames[0].buf, sizeof(ccd_frames_t),
+                              stream_xfer_cb, s, m->timeout);
+  }
+  for (i = 0; i < depth; i++) {
+    rc = stream_submit(&m->stream[i]);
+    if (rc != LIBUSB_SUCCESS) {
+      fprintf(stderr, ">> Could not submit stream transfer (%s)\n",
+              libusb_error_name(rc));
+      mightex_stream_stop(m);
+      return MTX_FAIL;
+    }
+  }
+  return MTX_OK;
+}
+
+int mightex_stream_poll(mightex_t *m, int timeout_ms) {
+  int rc;
+  unsigned long count;
+  struct timeval tv;
+  if (!m->stream)
+    return -1;
+  if (m->sim) {
+    rc = sim_stream_poll(m, timeout_ms);
+    mightex_service(m);
+    auto_exposure_apply(m);
+    return rc;
+  }
+  count = m->stream_count;
+  tv.tv_sec = timeout_ms / 1000;
+  tv.tv_usec = (timeout_ms % 1000) * 1000;
+  rc = libusb_handle_events_timeout_completed(m->ctx, &tv, NULL);
+  if (rc != LIBUSB_SUCCESS) {
+    fprintf(stderr, ">> Error handling events (%s)\n", libusb_error_name(rc));
+    return rc;
+  }
+  mightex_service(m);
+  auto_exposure_apply(m);
+  // a lost camera is still streaming, if it is going to be reconnected
+  if (stream_busy(m) == 0 && !(m->lost && m->auto_reconnect))
+    return -1;
+  return (int)(m->stream_count - count);
+}
+
+mtx_result_t mightex_stream_stop(mightex_t *m) {
+  int i;
+  struct timeval tv = {0, 100000};
+  double deadline;
+  if (!m->stream)
+    return MTX_FAIL;
+  m->stream_active = 0;
+  if (!m->sim) {
+    for (i = 0; i < m->stream_depth; i++) {
+      if (m->stream[i].cmd_busy)
+        libusb_cancel_transfer(m->stream[i].cmd);
+      if (m->stream[i].xfer_busy)
+        libusb_cancel_transfer(m->stream[i].xfer);
+    }
+    deadline = mtx_now_us() + m->timeout * 1000.0;
+    while (stream_busy(m) && mtx_now_us() < deadline)
+      libusb_handle_events_timeout_completed(m->ctx, &tv, NULL);
+    if (stream_busy(m)) {
+      // never free a transfer libusb still owns
+      fprintf(stderr, ">> Stream transfers did not terminate, leaking them\n");
+      m->stream = NULL;
+      m->stream_depth = 0;
+      return MTX_FAIL;
+    }
+  }
+  stream_free(m);
+  return MTX_OK;
+}
+
+int mightex_read_frames(mightex_t *m, int n) {
+  int rc, len = 0;
+  mtx_buf_t *b;
+  mightex_service(m);
+  if (n <= 0)
+    n = mightex_get_buffer_count(m);
+  if (n <= 0)
+    return n;
+  if (n > MTX_MAX_FRAMES)
+    n = MTX_MAX_FRAMES;
+  if (m->pool_frames && n > m->pool_frames)
+    n = m->pool_frames;
+  b = pool_get(m, n);
+  if (!b)
+    return -1;
+  CAM_LOCK(m);
+  if (mightex_prepare_buffered_data(m, (BYTE)n) != MTX_OK) {
+    CAM_UNLOCK(m);
+    buf_unref(b);
+    return -1;
+  }
+  rc = mightex_bulk(m, MTX_EP_FRAME, b->frames[0].buf,
+                    n * sizeof(ccd_frames_t), &len);
+  CAM_UNLOCK(m);
+  if (rc != LIBUSB_SUCCESS) {
+    fprintf(stderr, "Error on frames read: %s\n", libusb_error_name(rc));
+    buf_unref(b);
+    return -1;
+  }
+  n = len / sizeof(ccd_frames_t);
+  if (n == 0) {
+    buf_unref(b);
+    return 0;
+  }
+  mightex_store_frames(m, b, n);
+  auto_exposure_apply(m);
+  return n;
+}
+
+// Copy the i-th frame of the last read to dst, taking the pixels from data,
+// and its metadata to meta, if given
+static void acquire_copy(mightex_t *m, int i, const uint16_t *data,
+                         uint16_t *dst, uint16_t *meta) {
+  const ccd_frames_t *f = &m->cur->frames[i];
+  memcpy(dst, data, MTX_PIXELS * sizeof(uint16_t));
+  if (!meta)
+    return;
+  meta[MTX_META_TIMESTAMP] = f->frame.time_stamp;
+  meta[MTX_META_EXPTIME] = f->frame.exposure_time;
+  meta[MTX_META_TRIGGERED] = f->frame.trigger_occurred != 0;
+  meta[MTX_META_TRIGGER_COUNT] = f->frame.trigger_event_count;
+  meta[MTX_META_DARK_MEAN] = m->cur->dark_means[i];
+  meta[MTX_META_MISSED] =
+      m->cur->missed[i] > UINT16_MAX ? UINT16_MAX : m->cur->missed[i];
+}
+
+int mightex_acquire_into(mightex_t *m, uint16_t *dst, uint16_t *meta, int n,
+                         unsigned int flags) {
+  int i = 0, j, k;
+  int filtered = (flags & MTX_ACQUIRE_FILTERED) != 0;
+  const uint16_t *data;
+  if (m->stream && !m->queue)
+    return 0;
+  while (i < n) {
+    if (m->queue) {
+      if (mightex_pop_frame(m, m->timeout) != MTX_OK)
+        break;
+      k = 1;
+    } else {
+      k = mightex_wait_frame(m, m->timeout);
+      if (k <= 0)
+        break;
+      if (filtered)
+        k = mightex_read_frame(m) == MTX_OK ? 1 : 0;
+      else
+        k = mightex_read_frames(m, k < n - i ? k : n - i);
+      if (k <= 0)
+        break;
+    }
+    for (j = 0; j < k; j++, i++) {
+      data = ccd_pixels(&m->cur->frames[j]);
+      if (filtered) {
+        mightex_apply_filter(m, NULL);
+        data = mightex_frame_p(m);
+      }
+      acquire_copy(m, j, data, dst + (size_t)i * MTX_PIXELS,
+                   meta ? meta + (size_t)i * MTX_META_VALUES : NULL);
+    }
+  }
+  return i;
+}
+
+#ifdef MTX_THREADS
+mtx_result_t mightex_acquisition_start(mightex_t *m, int queue_len) {
+  mtx_queue_t *q;
+  unsigned long len = 1;
+  if (m->queue || m->stream || queue_len < 1)
+    return MTX_FAIL;
+  while (len < (unsigned long)queue_len)
+    len <<= 1;
+  q = calloc(1, sizeof(mtx_queue_t));
+  if (!q)
+    return MTX_FAIL;
+  q->slots = malloc(len * sizeof(mtx_buf_t *));
+  // a buffer per slot of the queue and per transfer
+  if (!q->slots || pool_reserve(m, len + MTX_MAX_FRAMES) != MTX_OK) {
+    free(q->slots);
+    free(q);
+    return MTX_FAIL;
+  }
+  q->mask = len - 1;
+  atomic_init(&q->head, 0);
+  atomic_init(&q->tail, 0);
+  atomic_init(&q->dropped, 0);
+  atomic_init(&q->running, 1);
+  m->queue = q;
+  // cameras on the shared context are all serviced by the same thread
+  if (m->shared && shared_events_retain(m) != MTX_OK)
+    goto fail;
+  if (mightex_stream_start(m, MTX_MAX_FRAMES, NULL, NULL) != MTX_OK) {
+    if (m->shared) {
+      shared_events_forget(m);
+      shared_events_release();
+    }
+    goto fail;
+  }
+  if (!m->shared &&
+      pthread_create(&q->thread, NULL, acquisition_loop, m) != 0) {
+    mightex_stream_stop(m);
+    goto fail;
+  }
+  return MTX_OK;
+fail:
+  m->queue = NULL;
+  free(q->slots);
+  free(q);
+  return MTX_FAIL;
+}
+
+mtx_result_t mightex_acquisition_stop(mightex_t *m) {
+  mtx_queue_t *q = m->queue;
+  unsigned long tail;
+  if (!q)
+    return MTX_FAIL;
+  atomic_store(&q->running, 0);
+  if (m->shared) {
+    shared_events_forget(m);
+    mightex_stream_stop(m);
+    shared_events_release();
+  } else {
+    pthread_join(q->thread, NULL);
+    mightex_stream_stop(m);
+  }
+  // frames never popped
+  for (tail = atomic_load(&q->tail); tail != atomic_load(&q->head); tail++)
+    buf_unref(q->slots[tail & q->mask]);
+  m->queue = NULL;
+  free(q->slots);
+  free(q);
+  return MTX_OK;
+}
+
+mtx_result_t mightex_try_pop_frame(mightex_t *m) {
+  mtx_queue_t *q = m->queue;
+  unsigned long tail;
+  if (!q)
+    return MTX_FAIL;
+  tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  if (tail == atomic_load_explicit(&q->head, memory_order_acquire))
+    return MTX_FAIL;
+  mightex_store_frames(m, q->slots[tail & q->mask], 1);
+  atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+  return MTX_OK;
+}
+
+mtx_result_t mightex_pop_frame(mightex_t *m, int timeout_ms) {
+  double deadline = mtx_now_us() + timeout_ms * 1000.0;
+  if (!m->queue)
+    return MTX_FAIL;
+  while (mightex_try_pop_frame(m) != MTX_OK) {
+    if (mtx_now_us() >= deadline)
+      return MTX_FAIL;
+    mtx_sleep_us(MTX_POP_POLL_US);
+  }
+  return MTX_OK;
+}
+
+unsigned long mightex_dropped_frames(mightex_t *m) {
+  if (!m->queue)
+    return 0;
+  return atomic_load_explicit(&m->queue->dropped, memory_order_relaxed);
+}
+#else
+mtx_result_t mightex_acquisition_start(mightex_t *m, int queue_len) {
+  fprintf(stderr, ">> Acquisition thread not supported on this platform\n");
+  return MTX_FAIL;
+}
+
+mtx_result_t mightex_acquisition_stop(mightex_t *m) { return MTX_FAIL; }
+
+mtx_result_t mightex_try_pop_frame(mightex_t *m) { return MTX_FAIL; }
+
+mtx_result_t mightex_pop_frame(mightex_t *m, int timeout_ms) {
+  return MTX_FAIL;
+}
+
+unsigned long mightex_dropped_frames(mightex_t *m) { return 0; }
+#endif
+
+#ifdef MTX_RINGS
+mightex_ring_t *mightex_ring_create(const char *path, int frames) {
+  return ring_writer(path, frames, 0);
+}
+
+mightex_ring_t *mightex_ring_create_shared(const char *name, int frames) {
+  return ring_writer(name, frames, 1);
+}
+
+mightex_ring_t *mightex_ring_open(const char *path) {
+  return ring_reader(path, 0);
+}
+
+mightex_ring_t *mightex_ring_open_shared(const char *name) {
+  return ring_reader(name, 1);
+}
+
+mtx_result_t mightex_ring_remove_shared(const char *name) {
+  return shm_unlink(name) == 0 ? MTX_OK : MTX_FAIL;
+}
+
+void mightex_ring_close(mightex_ring_t *r) {
+  if (!r)
+    return;
+  if (r->writer)
+    close(r->fd);
+  ring_unmap(r);
+}
+
+uint64_t mightex_ring_count(mightex_ring_t *r) {
+  return atomic_load_explicit(&r->header->committed, memory_order_acquire);
+}
+
+int mightex_ring_capacity(mightex_ring_t *r) { return (int)r->capacity; }
+
+mtx_result_t mightex_ring_read(mightex_ring_t *r, uint64_t index,
+                               uint16_t *pixels, uint16_t *meta) {
+  uint64_t tag = index + 1;
+  mtx_record_t *rec = &r->records[index % r->capacity];
+  const struct frame *f = &rec->frame.frame;
+  if (atomic_load_explicit(&rec->end, memory_order_acquire) != tag)
+    return MTX_FAIL;
+  if (pixels)
+    memcpy(pixels, f->image_data, MTX_PIXELS * sizeof(uint16_t));
+  if (meta) {
+    meta[MTX_META_TIMESTAMP] = f->time_stamp;
+    meta[MTX_META_EXPTIME] = f->exposure_time;
+    meta[MTX_META_TRIGGERED] = f->trigger_occurred != 0;
+    meta[MTX_META_TRIGGER_COUNT] = f->trigger_event_count;
+    meta[MTX_META_DARK_MEAN] = rec->dark_mean;
+    meta[MTX_META_MISSED] = rec->missed;
+  }
+  // the writer came round while copying
+  atomic_thread_fence(memory_order_acquire);
+  if (atomic_load_explicit(&rec->begin, memory_order_relaxed) != tag)
+    return MTX_FAIL;
+  return MTX_OK;
+}
+mtx_result_t mightex_ring_next(mightex_ring_t *r, uint64_t *cursor,
+                               uint16_t *pixels, uint16_t *meta,
+                               int timeout_ms) {
+  double deadline = mtx_now_us() + timeout_ms * 1000.0;
+  uint64_t count;
+  for (;;) {
+    count = mightex_ring_count(r);
+    if (*cursor < count) {
+      // overtaken by the writer: go on from the newest frame
+      if (count - *cursor > r->capacity)
+        *cursor = count - 1;
+      if (mightex_ring_read(r, *cursor, pixels, meta) == MTX_OK) {
+        (*cursor)++;
+        return MTX_OK;
+      }
+      *cursor = mightex_ring_count(r) - 1;
+      continue;
+    }
+    if (mtx_now_us() >= deadline)
+      return MTX_FAIL;
+    mtx_sleep_us(MTX_POP_POLL_US);
+  }
+}
+#else
+mightex_ring_t *mightex_ring_create(const char *path, int frames) {
+  fprintf(stderr, ">> Frame rings not supported on this platform\n");
+  return NULL;
+}
+
+mightex_ring_t *mightex_ring_create_shared(const char *name, int frames) {
+  fprintf(stderr, ">> Frame rings not supported on this platform\n");
+  return NULL;
+}
+
+mightex_ring_t *mightex_ring_open(const char *path) {
+  fprintf(stderr, ">> Frame rings not supported on this platform\n");
+  return NULL;
+}
+
+mightex_ring_t *mightex_ring_open_shared(const char *name) {
+  fprintf(stderr, ">> Frame rings not supported on this platform\n");
+  return NULL;
+}
+
+mtx_result_t mightex_ring_remove_shared(const char *name) { return MTX_FAIL; }
+
+void mightex_ring_close(mightex_ring_t *r) {}
+
+uint64_t mightex_ring_count(mightex_ring_t *r) { return 0; }
+
+int mightex_ring_capacity(mightex_ring_t *r) { return 0; }
+
+mtx_result_t mightex_ring_read(mightex_ring_t *r, uint64_t index,
+                               uint16_t *pixels, uint16_t *meta) {
+  return MTX_FAIL;
+}
+
+mtx_result_t mightex_ring_next(mightex_ring_t *r, uint64_t *cursor,
+                               uint16_t *pixels, uint16_t *meta,
+                               int timeout_ms) {
+  return MTX_FAIL;
+}
+#endif
+
+mtx_result_t mightex_set_recorder(mightex_t *m, mightex_ring_t *r) {
+  return ring_attach(m, &m->recorder, r);
+}
+
+mtx_result_t mightex_set_publisher(mightex_t *m, mightex_ring_t *r) {
+  return ring_attach(m, &m->publisher, r);
+}
+
+mtx_result_t mightex_set_auto_reconnect(mightex_t *m, int enable) {
+  int rc;
+  if (!enable) {
+    if (m->auto_reconnect > 1)
+      libusb_hotplug_deregister_callback(m->ctx, m->hotplug);
+    m->auto_reconnect = 0;
+    return MTX_OK;
+  }
+  if (m->auto_reconnect)
+    return MTX_OK;
+  m->auto_reconnect = 1;
+  // without hotplug support, lost cameras are just looked for periodically
+  if (m->sim || !libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG))
+    return MTX_OK;
+  rc = libusb_hotplug_register_callback(
+      m->ctx,
+      LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT, 0,
+      USB_IDVENDOR, USB_IDPRODUCT, LIBUSB_HOTPLUG_MATCH_ANY, hotplug_cb, m,
+      &m->hotplug);
+  if (rc != LIBUSB_SUCCESS)
+    fprintf(stderr, ">> Could not register hotplug callback (%s)\n",
+            libusb_error_name(rc));
+  else
+    m->auto_reconnect = 2;
+  return MTX_OK;
+}
+
+void mightex_auto_exposure_defaults(mightex_auto_exposure_t *ae) {
+  ae->target = 40000;
+  ae->tolerance = 0.1f;
+  ae->saturation = MTX_SATURATION;
+  ae->max_saturated = 0;
+  ae->min_exptime = 0.1f;
+  ae->max_exptime = 6553.5f;
+  ae->max_ratio = 4.0f;
+  ae->min_interval_ms = 0;
+}
+
+mtx_result_t mightex_set_auto_exposure(mightex_t *m,
+                                       const mightex_auto_exposure_t *ae) {
+  m->ae_pending = 0;
+  if (!ae) {
+    m->ae_enabled = 0;
+    return MTX_OK;
+  }
+  if (ae->target == 0 || ae->max_ratio <= 1 || ae->tolerance < 0 ||
+      ae->min_exptime < 0.1f || ae->max_exptime < ae->min_exptime) {
+    fprintf(stderr, ">> Invalid auto-exposure settings\n");
+    return MTX_FAIL;
+  }
+  m->ae = *ae;
+  m->ae_last = 0;
+  m->ae_enabled = 1;
+  return MTX_OK;
+}
+
+mtx_result_t mightex_calibrate_dark(mightex_t *m, int n) {
+  int i;
+  mtx_calib_t *c;
+  mtx_result_t rc = MTX_FAIL;
+  uint32_t *sum = malloc(MTX_PIXELS * sizeof(uint32_t));
+
+  if (!sum)
+    return MTX_FAIL;
+  if (calib_capture(m, n, sum) == MTX_OK &&
+      (c = calib_slot(m, exptime_units(m->exptime))) != NULL) {
+    for (i = 0; i < MTX_PIXELS; i++) {
+      c->dark[i] = (uint16_t)((sum[i] + n / 2) / n);
+      c->gain[i] = MTX_GAIN_ONE;
+    }
+    c->flat = 0;
+    rc = MTX_OK;
+  }
+  free(sum);
+  return rc;
+}
+
+mtx_result_t mightex_calibrate_flat(mightex_t *m, int n) {
+  int i, lit = 0;
+  double v, mean = 0, g;
+  mtx_calib_t *c = calib_find(m, exptime_units(m->exptime));
+  uint32_t *sum;
+
+  if (!c) {
+    fprintf(stderr, ">> No dark calibration at %.1f ms\n", m->exptime);
+    return MTX_FAIL;
+  }
+  sum = malloc(MTX_PIXELS * sizeof(uint32_t));
+  if (!sum || calib_capture(m, n, sum) != MTX_OK) {
+    free(sum);
+    return MTX_FAIL;
+  }
+  for (i = 0; i < MTX_PIXELS; i++) {
+    if (sum[i] / n >= MTX_SATURATION) {
+      fprintf(stderr, ">> Flat field saturated at pixel %d\n", i);
+      free(sum);
+      return MTX_FAIL;
+    }
+    v = (double)sum[i] / n - c->dark[i];
+    if (v > 0) {
+      mean += v;
+      lit++;
+    }
+  }
+  if (lit == 0) {
+    fprintf(stderr, ">> No light in the flat field\n");
+    free(sum);
+    return MTX_FAIL;
+  }
+  mean /= lit;
+  // pixels with less than 1/16 of the average response are left alone
+  for (i = 0; i < MTX_PIXELS; i++) {
+    v = (double)sum[i] / n - c->dark[i];
+    g = v > mean / 16 ? mean / v * MTX_GAIN_ONE + 0.5 : MTX_GAIN_ONE;
+    c->gain[i] = g < 65535 ? (uint16_t)g : 65535;
+  }
+  c->flat = 1;
+  free(sum);
+  return MTX_OK;
+}
+
+mtx_result_t mightex_calibration_save(mightex_t *m, const char *path) {
+  int ok;
+  FILE *f;
+  mtx_calib_header_t h;
+
+  memset(&h, 0, sizeof(h));
+  h.magic = MTX_CALIB_MAGIC;
+  h.pixels = MTX_PIXELS;
+  h.count = (uint16_t)m->n_calib;
+  memcpy(h.serial_no, m->device_info.di.serial_no, STRING_LENGTH);
+  f = fopen(path, "wb");
+  if (!f) {
+    fprintf(stderr, ">> Could not write %s\n", path);
+    return MTX_FAIL;
+  }
+  ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+       fwrite(m->calib, sizeof(mtx_calib_t), m->n_calib, f) ==
+           (size_t)m->n_calib;
+  ok = fclose(f) == 0 && ok;
+  return ok ? MTX_OK : MTX_FAIL;
+}
+
+mtx_result_t mightex_calibration_load(mightex_t *m, const char *path) {
+  FILE *f;
+  mtx_calib_header_t h;
+  mtx_result_t rc = MTX_FAIL;
+
+  f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, ">> Could not read %s\n", path);
+    return MTX_FAIL;
+  }
+  if (fread(&h, sizeof(h), 1, f) != 1 || h.magic != MTX_CALIB_MAGIC ||
+      h.pixels != MTX_PIXELS || h.count > MTX_MAX_CALIB) {
+    fprintf(stderr, ">> %s is not a calibration file\n", path);
+  } else if (memcmp(h.serial_no, m->device_info.di.serial_no,
+                    STRING_LENGTH) != 0) {
+    fprintf(stderr, ">> %s belongs to camera %.*s\n", path, STRING_LENGTH,
+            h.serial_no);
+  } else if (!m->calib &&
+             !(m->calib = malloc(MTX_MAX_CALIB * sizeof(mtx_calib_t)))) {
+    fprintf(stderr, ">> Out of memory\n");
+  } else if (fread(m->calib, sizeof(mtx_calib_t), h.count, f) != h.count) {
+    fprintf(stderr, ">> %s is truncated\n", path);
+    m->n_calib = 0;
+  } else {
+    m->n_calib = h.count;
+    rc = MTX_OK;
+  }
+  fclose(f);
+  return rc;
+}
+
+void mightex_calibration_clear(mightex_t *m) { m->n_calib = 0; }
+
+int mightex_calibration_count(mightex_t *m) { return m->n_calib; }
+
+void mightex_filter_calibrated(mightex_t *m, uint16_t *const data,
+                               uint16_t len, void *ud) {
+  // the tables for the exposure time of the frame, not the current setting
+  const mtx_calib_t *c = calib_find(m, m->cur->frames[0].frame.exposure_time);
+  int x0 = data_offset(m, data);
+  if (c)
+    dark_gain(data, c->dark + x0, c->gain + x0, len);
+  else
+    filter_dark(m, data, len, ud);
+}
+
+mightex_accumulator_t *mightex_accumulator_new(uint16_t frames,
+                                              mtx_acc_mode_t mode) {
+  mightex_accumulator_t *acc;
+  if (frames == 0) {
+    fprintf(stderr, ">> An accumulator needs at least one frame\n");
+    return NULL;
+  }
+  acc = calloc(1, sizeof(mightex_accumulator_t));
+  if (!acc)
+    return NULL;
+  acc->mode = mode;
+  acc->frames = frames;
+  if (mode == MTX_ACC_SLIDING &&
+      !(acc->ring = malloc((size_t)frames * MTX_PIXELS * sizeof(uint16_t)))) {
+    free(acc);
+    return NULL;
+  }
+  return acc;
+}
+
+void mightex_accumulator_free(mightex_accumulator_t *acc) {
+  if (!acc)
+    return;
+  free(acc->ring);
+  free(acc);
+}
+
+void mightex_accumulator_reset(mightex_accumulator_t *acc) {
+  memset(acc->sum, 0, sizeof(acc->sum));
+  memset(acc->sq, 0, sizeof(acc->sq));
+  acc->count = 0;
+  acc->next = 0;
+}
+
+int mightex_accumulator_add(mightex_accumulator_t *acc, const uint16_t *data) {
+  uint16_t *slot;
+  if (acc->mode == MTX_ACC_BLOCK) {
+    // a complete block is kept until the next frame starts a new one
+    if (acc->count == acc->frames)
+      mightex_accumulator_reset(acc);
+    acc_add(acc->sum, acc->sq, data, MTX_PIXELS);
+    return ++acc->count;
+  }
+  slot = acc->ring + (size_t)acc->next * MTX_PIXELS;
+  if (acc->count == acc->frames) {
+    acc_replace(acc->sum, acc->sq, data, slot, MTX_PIXELS);
+  } else {
+    acc_add(acc->sum, acc->sq, data, MTX_PIXELS);
+    acc->count++;
+  }
+  memcpy(slot, data, MTX_PIXELS * sizeof(uint16_t));
+  acc->next = (acc->next + 1) % acc->frames;
+  return acc->count;
+}
+
+int mightex_accumulator_add_frame(mightex_accumulator_t *acc, mightex_t *m) {
+  return mightex_accumulator_add(acc, ccd_pixels(&m->cur->frames[0]));
+}
+
+int mightex_accumulator_count(mightex_accumulator_t *acc) {
+  return acc->count;
+}
+
+const uint32_t *mightex_accumulator_sum(mightex_accumulator_t *acc) {
+  return acc->sum;
+}
+
+void mightex_accumulator_mean(mightex_accumulator_t *acc, double *mean) {
+  int i;
+  for (i = 0; i < MTX_PIXELS; i++)
+    mean[i] = acc->count ? (double)acc->sum[i] / acc->count : 0;
+}
+
+void mightex_accumulator_variance(mightex_accumulator_t *acc, double *var) {
+  int i;
+  double n = acc->count, s, v;
+  for (i = 0; i < MTX_PIXELS; i++) {
+    if (acc->count < 2) {
+      var[i] = 0;
+      continue;
+    }
+    s = acc->sum[i];
+    v = ((double)acc->sq[i] - s * s / n) / (n - 1);
+    var[i] = v > 0 ? v : 0;
+  }
+}
+
+mtx_result_t mightex_simulate_scene(mightex_t *m, mtx_sim_scene_t scene) {
+  if (!m->sim)
+    return MTX_FAIL;
+  SIM_LOCK(m->sim);
+  m->sim->scene = scene;
+  sim_set_exptime(m->sim, m->sim->exptime);
+  SIM_UNLOCK(m->sim);
+  return MTX_OK;
+}
+
+mtx_result_t mightex_simulate_trigger(mightex_t *m, float hz) {
+  if (!m->sim)
+    return MTX_FAIL;
+  SIM_LOCK(m->sim);
+  m->sim->trigger_period = hz > 0 ? 1.0E6 / hz : 0;
+  if (m->sim->mode == MTX_TRIGGER_MODE)
+    sim_restart(m->sim, mtx_now_us());
+  SIM_UNLOCK(m->sim);
+  return MTX_OK;
+}
+
+mtx_result_t mightex_simulate_unplug(mightex_t *m, int ms) {
+  if (!m->sim)
+    return MTX_FAIL;
+  SIM_LOCK(m->sim);
+  m->sim->unplugged_until = mtx_now_us() + ms * 1000.0;
+  SIM_UNLOCK(m->sim);
+  return MTX_OK;
+}
+
+void mightex_gpio_write(mightex_t *m, BYTE reg, BYTE val) {
+  BYTE buf[4] = {MTX_CMD_GPIOWRITE, 0x02, reg, val};
+  mightex_send(m, buf, sizeof(buf));
+}
+
+BYTE mightex_gpio_read(mightex_t *m, BYTE reg) {
+  int rc;
+  BYTE buf[3] = {MTX_CMD_GPIOREAD, 0x03, reg};
+  CAM_LOCK(m);
+  mightex_send(m, buf, sizeof(buf));
+  rc = mightex_receive(m, buf, sizeof(buf));
+  CAM_UNLOCK(m);
+  if (rc <= 0)
+    return -1;
+  return buf[2];
+}
+
+// Copy the current frame to its view, if not done yet, and return the view.
+// The whole frame is copied, windows or not, so that the pixels the filter
+// skips are the raw ones rather than those of an older frame; without a
+// filter there is no copy.
+static uint16_t *mightex_sync_data(mightex_t *m) {
+  uint16_t *data = frame_view(m), *raw = ccd_pixels(&m->cur->frames[0]);
+  if (!m->stale || data == raw)
+    return data;
+  memcpy(data, raw, MTX_PIXELS * sizeof(uint16_t));
+  m->stale = 0;
+  return data;
+}
+
+void mightex_apply_filter(mightex_t *m, void *ud) {
+  int i, n;
+  mightex_roi_t spans[MTX_MAX_ROI];
+  uint16_t *data = mightex_sync_data(m);
+  if (!m->filter)
+    return;
+  n = roi_spans(m, spans);
+  for (i = 0; i < n; i++)
+    m->filter(m, data + spans[i].start, spans[i].width, ud);
+  m->cur->filtered = 1;
+}
+
+double mightex_apply_estimator(mightex_t *m, void *ud) {
+  double x;
+  mightex_roi_t w = roi_primary(m);
+  uint16_t *data = mightex_sync_data(m);
+  if (!m->estimator)
+    return 0.0;
+  x = m->estimator(m, data + w.start, w.width, ud);
+  roi_track(m, x);
+  return x;
+}
+
+int mightex_apply_multi_estimator(mightex_t *m, void *ud, double *out,
+                                  int max) {
+  int i, n, count = 0;
+  mightex_roi_t spans[MTX_MAX_ROI];
+  uint16_t *data = mightex_sync_data(m);
+  if (!m->multi_estimator)
+    return 0;
+  n = roi_spans(m, spans);
+  for (i = 0; i < n && count < max; i++)
+    count += m->multi_estimator(m, data + spans[i].start, spans[i].width,
+                                ud, out + count, max - count);
+  return count;
+}
+
+double mightex_estimator_stats(mightex_t *m, uint16_t *const data,
+                               uint16_t len, void *ud) {
+  mightex_stats_t *s = (mightex_stats_t *)ud;
+  mtx_stats_acc_t a;
+  uint64_t n = len;
+  int bits;
+
+  if (!s || len == 0)
+    return 0.0;
+  stats(data, len, s->saturation ? s->saturation : MTX_SATURATION, &a);
+  s->min = a.min;
+  s->max = a.max;
+  s->saturated = a.saturated;
+  s->mean = (double)a.sum / n;
+  // n * sq - sum^2 is exact in 64 bits for frames of up to 65535 pixels
+  s->std = n > 1 ? sqrt((double)(n * a.sq - a.sum * a.sum) / (n * (n - 1)))
+                 : 0.0;
+  if (s->histogram) {
+    bits = s->histogram_bits ? s->histogram_bits : 8;
+    histogram(data, len, bits > 16 ? 16 : bits, s->histogram);
+  }
+  return s->std;
+}
+
+int mightex_find_peaks(mightex_t *m, const mightex_peak_options_t *opt,
+                       mightex_peak_t *peaks, int max) {
+  int i, n, count = 0;
+  mightex_roi_t spans[MTX_MAX_ROI];
+  uint16_t *data = mightex_sync_data(m);
+  n = roi_spans(m, spans);
+  for (i = 0; i < n && count < max * MTX_PEAK_VALUES; i++)
+    count += estimator_peaks(m, data + spans[i].start, spans[i].width,
+                             (void *)opt, (double *)peaks + count,
+                             max * MTX_PEAK_VALUES - count);
+  return count / MTX_PEAK_VALUES;
+}
+
+double mightex_process(mightex_t *m, void *ud) {
+  uint64_t num, den;
+  double x;
+  mightex_roi_t w = roi_primary(m);
+  // fused only when window 0 is the one span filtered (or the full frame):
+  // other windows touching it would be merged into its span
+  if (m->filter == filter_dark && m->estimator == estimator_center &&
+      (m->n_roi <= 1 || m->searching)) {
+    uint16_t *data = frame_view(m), *raw = ccd_pixels(&m->cur->frames[0]);
+    if (m->stale)
+      roi_fill_outside(raw, data, &w, 1);
+    dark_centroid(raw + w.start, data + w.start, w.width, m->dark_mean,
+                  m->dark_mean * 3, &num, &den);
+    m->stale = 0;
+    m->cur->filtered = 1;
+    num += (uint64_t)w.start * den;
+    x = (double)num / (double)den;
+    roi_track(m, x);
+    return x;
+  }
+  m->stale = 1;
+  mightex_apply_filter(m, ud);
+  return mightex_apply_estimator(m, ud);
+}
+
+mightex_frame_t *mightex_frame_hold(mightex_t *m, int i) {
+  if (i < 0 || i >= m->frame_count)
+    return NULL;
+  buf_ref(m->cur);
+  return &m->cur->handles[i];
+}
+
+mightex_frame_t *mightex_frame_retain(mightex_frame_t *f) {
+  buf_ref(f->buf);
+  return f;
+}
+
+void mightex_frame_release(mightex_frame_t *f) {
+  if (f)
+    buf_unref(f->buf);
+}
+
+const uint16_t *mightex_frame_pixels(mightex_frame_t *f) {
+  return ccd_pixels(&f->buf->frames[f->index]);
+}
+
+const uint16_t *mightex_frame_filtered(mightex_frame_t *f) {
+  return f->index == 0 && f->buf->filtered ? f->buf->view : NULL;
+}
+
+mtx_result_t mightex_frame_info(mightex_frame_t *f,
+                                mightex_frame_meta_t *meta) {
+  const ccd_frames_t *c = &f->buf->frames[f->index];
+  meta->timestamp = c->frame.time_stamp;
+  meta->exptime = c->frame.exposure_time / 10.0f;
+  meta->triggered = c->frame.trigger_occurred != 0;
+  meta->trigger_count = c->frame.trigger_event_count;
+  meta->missed = f->buf->missed[f->index];
+  return MTX_OK;
+}
+
+uint16_t mightex_frame_dark_mean(mightex_frame_t *f) {
+  return f->buf->dark_means[f->index];
+}
+
+size_t mightex_buffer_pool_size(int buffers, int frames) {
+  return buffers * MTX_BUFFER_STRIDE(frames) + MTX_BUFFER_ALIGN - 1;
+}
+
+mtx_result_t mightex_set_buffer_pool(mightex_t *m, void *mem, size_t size,
+                                     int frames) {
+  int i, n = 0;
+  mtx_buf_t *b;
+  BYTE *base = NULL;
+  size_t stride = MTX_BUFFER_STRIDE(frames);
+
+  if (m->stream || m->queue)
+    return MTX_FAIL;
+  if (mem) {
+    if (frames < 1 || frames > MTX_MAX_FRAMES)
+      return MTX_FAIL;
+    base = (BYTE *)MTX_BUFFER_ROUND((uintptr_t)mem);
+    if ((BYTE *)mem + size > base)
+      n = (int)(((BYTE *)mem + size - base) / stride);
+    // the current frame and the next read
+    if (n < 2) {
+      fprintf(stderr, ">> Buffer pool too small\n");
+      return MTX_FAIL;
+    }
+  }
+  // the buffers of the previous region must be free, so that it can go
+  for (b = m->pool; b; b = b->next) {
+    if (buf_refs(b) != (b == m->cur ? 2 : 1)) {
+      fprintf(stderr, ">> Frames of the buffer pool are still held\n");
+      return MTX_FAIL;
+    }
+  }
+  pool_free(m);
+  m->pool_frames = 0;
+  for (i = 0; i < n; i++) {
+    if (!pool_link(m, frames, base + i * stride)) {
+      pool_free(m);
+      pool_init(m);
+      return MTX_FAIL;
+    }
+  }
+  m->pool_frames = mem ? frames : 0;
+  m->frame_count = 0;
+  return pool_init(m);
+}
+
+//      _
+//     / \   ___ ___ ___  ___ ___  ___  _ __ ___
+//    / _ \ / __/ __/ _ \/ __/ __|/ _ \| '__/ __|
 //   / ___ \ (_| (_|  __/\__ \__ \ (_) | |  \__ \
 //  /_/   \_\___\___\___||___/___/\___/|_|  |___/
 
@@ -404,22 +4234,110 @@ char *mightex_serial_no(mightex_t *m) {
 
 char *mightex_version(mightex_t *m) { return m->version; }
 
+float mightex_exptime(mightex_t *m) { return m->exptime; }
+
+const char *mightex_simd() {
+#ifdef MTX_AVX2
+  if (cpu_has_avx2())
+    return "avx2";
+#endif
+#if defined(MTX_SSE2)
+  return "sse2";
+#elif defined(MTX_NEON)
+  return "neon";
+#else
+  return "scalar";
+#endif
+}
+
 char *mightex_sw_version() { return "Mightex1304 v." GIT_COMMIT_HASH " for " CMAKE_PLATFORM ", " CMAKE_BUILD_TYPE " build."; }
 
-uint16_t *mightex_frame_p(mightex_t *m) { return m->data; }
+uint16_t *mightex_frame_p(mightex_t *m) { return mightex_sync_data(m); }
+
+uint16_t *mightex_frame_output(mightex_t *m) {
+  int n;
+  mightex_roi_t spans[MTX_MAX_ROI];
+  uint16_t *data = frame_output(m);
+  if (!data)
+    return NULL;
+  if (m->stale) {
+    n = roi_spans(m, spans);
+    roi_fill_outside(ccd_pixels(&m->cur->frames[0]), data, spans, n);
+  }
+  m->stale = 0;
+  m->cur->filtered = 1;
+  return data;
+}
 
 uint16_t *mightex_raw_frame_p(mightex_t *m) {
-  return m->frames[0].frame.image_data;
+  return ccd_pixels(&m->cur->frames[0]);
 }
 
 uint16_t mightex_frame_timestamp(mightex_t *m) {
-  return m->frames[0].frame.time_stamp;
+  return m->cur->frames[0].frame.time_stamp;
 }
 
 uint16_t mightex_dark_mean(mightex_t *m) { return m->dark_mean; }
 
+unsigned long mightex_gap_count(mightex_t *m) { return m->gaps; }
+
+unsigned long mightex_dropped_triggers(mightex_t *m) {
+  return m->dropped_triggers;
+}
+
+mtx_result_t mightex_frame_meta(mightex_t *m, mightex_frame_meta_t *meta) {
+  return mightex_frame_meta_at(m, 0, meta);
+}
+
+mtx_result_t mightex_frame_meta_at(mightex_t *m, int i,
+                                   mightex_frame_meta_t *meta) {
+  if (i < 0 || i >= m->frame_count)
+    return MTX_FAIL;
+  return mightex_frame_info(&m->cur->handles[i], meta);
+}
+
+int mightex_frame_count(mightex_t *m) { return m->frame_count; }
+
+uint16_t *mightex_raw_frame_at(mightex_t *m, int i) {
+  if (i < 0 || i >= m->frame_count)
+    return NULL;
+  return ccd_pixels(&m->cur->frames[i]);
+}
+
+uint16_t mightex_frame_timestamp_at(mightex_t *m, int i) {
+  if (i < 0 || i >= m->frame_count)
+    return 0;
+  return m->cur->frames[i].frame.time_stamp;
+}
+
+uint16_t mightex_dark_mean_at(mightex_t *m, int i) {
+  if (i < 0 || i >= m->frame_count)
+    return 0;
+  return m->cur->dark_means[i];
+}
+
 uint16_t mightex_pixel_count(mightex_t *m) { return MTX_PIXELS; }
 
+int mightex_roi(mightex_t *m, mightex_roi_t *roi, int max) {
+  if (roi && max > 0)
+    memcpy(roi, m->roi,
+           (max < m->n_roi ? max : m->n_roi) * sizeof(mightex_roi_t));
+  return m->n_roi;
+}
+
+int mightex_roi_searching(mightex_t *m) { return m->searching; }
+
+unsigned long mightex_roi_searches(mightex_t *m) { return m->searches; }
+
+int mightex_roi_spans(mightex_t *m, mightex_roi_t *spans) {
+  return roi_spans(m, spans);
+}
+
+double mightex_roi_track(mightex_t *m, double x) {
+  roi_track(m, x);
+  return x;
+}
+
 uint16_t mightex_dark_pixel_count(mightex_t *m) { return MTX_DARK_PIXELS; }
 
 void mightex_set_filter(mightex_t *m, mightex_filter_t *filter) {
@@ -433,3 +4351,44 @@ void mightex_set_estimator(mightex_t *m, mightex_estimator_t *estimator) {
 }
 
 void mightex_reset_estimator(mightex_t *m) { m->estimator = estimator_center; }
+
+void mightex_set_multi_estimator(mightex_t *m,
+                                 mightex_multi_estimator_t *estimator) {
+  m->multi_estimator = estimator;
+}
+
+void mightex_reset_multi_estimator(mightex_t *m) {
+  m->multi_estimator = estimator_peaks;
+}
+
+mtx_result_t mightex_set_roi(mightex_t *m, const mightex_roi_t *roi, int n) {
+  int i;
+  if (n < 0 || n > MTX_MAX_ROI || (n > 0 && !roi)) {
+    fprintf(stderr, ">> Up to %d windows can be set\n", MTX_MAX_ROI);
+    return MTX_FAIL;
+  }
+  for (i = 0; i < n; i++) {
+    if (roi[i].width == 0 || roi[i].start + roi[i].width > MTX_PIXELS) {
+      fprintf(stderr, ">> Window %d [%u, %u) out of the sensor\n", i,
+              roi[i].start, roi[i].start + roi[i].width);
+      return MTX_FAIL;
+    }
+  }
+  if (n > 0)
+    memcpy(m->roi, roi, n * sizeof(mightex_roi_t));
+  m->n_roi = n;
+  m->searching = 0;
+  if (n == 0)
+    m->tracking = 0;
+  return MTX_OK;
+}
+
+mtx_result_t mightex_set_roi_tracking(mightex_t *m, int enable) {
+  if (enable && m->n_roi == 0) {
+    fprintf(stderr, ">> Tracking needs a window to follow\n");
+    return MTX_FAIL;
+  }
+  m->tracking = enable != 0;
+  m->searching = 0;
+  return MTX_OK;
+}
@@ -39,71 +39,1153 @@ extern "C" {
  */
 #define MTX_DARK_PIXELS 13
 
+/**
+ * @brief Number of frames the camera can buffer internally
+ * 
+ * @see mightex_get_buffer_count and mightex_read_frames
+ */
+#define MTX_MAX_FRAMES 4
+
+/**
+ * @brief Alignment of frames and filtered views in a caller's buffer pool
+ * 
+ * @see mightex_set_buffer_pool
+ */
+#define MTX_BUFFER_ALIGN 64
+
 typedef unsigned char BYTE;
 
 /**
- * @brief The two possible operating modes: continuous or triggered
+ * @brief The two possible operating modes: continuous or triggered
+ */
+typedef enum { MTX_NORMAL_MODE = 0, MTX_TRIGGER_MODE = 1 } mtx_mode_t;
+
+/**
+ * @brief Standard exit values for library functions
+ */
+typedef enum { MTX_FAIL = 0, MTX_OK = 1 } mtx_result_t;
+
+/**
+ * @brief What the simulated camera looks at
+ * 
+ * @see mightex_simulate_scene
+ */
+typedef enum {
+  MTX_SCENE_SPOT = 0, ///< a gaussian spot at the center of the sensor
+  MTX_SCENE_DARK = 1, ///< nothing: the sensor is covered
+  MTX_SCENE_FLAT = 2, ///< a uniform light, for flat-field calibration
+  MTX_SCENE_LINES = 3 ///< three narrow lines of decreasing intensity
+} mtx_sim_scene_t;
+
+/**
+ * @brief How a frame accumulator treats the frames beyond the N-th
+ * 
+ * @see mightex_accumulator_new
+ */
+typedef enum {
+  MTX_ACC_BLOCK = 0,  ///< sums restart once N frames have been summed
+  MTX_ACC_SLIDING = 1 ///< sums are over the last N frames
+} mtx_acc_mode_t;
+
+/**
+ * @brief Flags for @ref mightex_open, to be OR-ed together
+ */
+typedef enum {
+  MTX_OPEN_DEFAULT = 0,  ///< Reset the device and query all of its details
+  MTX_OPEN_NO_RESET = 1, ///< Do not reset the device
+  MTX_OPEN_CACHE = 2     ///< Use (and update) the on-disk device cache
+} mtx_open_flags_t;
+
+/**
+ * @brief Flags for @ref mightex_acquire_into, to be OR-ed together
+ */
+typedef enum {
+  MTX_ACQUIRE_RAW = 0,     ///< Copy the raw frames, read in bursts
+  MTX_ACQUIRE_FILTERED = 1 ///< Apply the filter and copy the filtered frames
+} mtx_acquire_flags_t;
+
+/**
+ * @brief Per-frame values written by @ref mightex_acquire_into, in order
+ */
+typedef enum {
+  MTX_META_TIMESTAMP = 0,     ///< camera timestamp, in ms
+  MTX_META_EXPTIME = 1,       ///< exposure time, in units of 0.1 ms
+  MTX_META_TRIGGERED = 2,     ///< 1 if the frame was started by a trigger
+  MTX_META_TRIGGER_COUNT = 3, ///< the camera trigger event counter
+  MTX_META_DARK_MEAN = 4,     ///< the mean of the shielded pixels
+  MTX_META_MISSED = 5,        ///< triggers missed since the previous frame
+  MTX_META_VALUES = 6         ///< number of values per frame
+} mtx_meta_index_t;
+
+/**
+ * @brief Time spent in each phase of @ref mightex_open, in milliseconds
+ */
+typedef struct {
+  double enumerate;   ///< listing devices and loading the cache
+  double open;        ///< opening the device and claiming its interface
+  double reset;       ///< resetting the device
+  double descriptors; ///< reading the string descriptors (or the cache)
+  double info;        ///< querying firmware version and device info
+  double total;       ///< the whole call
+} mightex_open_times_t;
+
+/**
+ * @brief Per-frame metadata, as reported by the camera
+ * 
+ * @see mightex_frame_meta
+ */
+typedef struct {
+  uint16_t timestamp;     ///< camera timestamp, in ms
+  float exptime;          ///< exposure time, in ms
+  int triggered;          ///< 1 if the frame was started by a trigger
+  uint16_t trigger_count; ///< the camera trigger event counter
+  unsigned int missed;    ///< triggers missed since the previous frame
+} mightex_frame_meta_t;
+
+/**
+ * @brief A peak found by the multi-peak estimator
+ * 
+ * Made of @ref MTX_PEAK_VALUES doubles, so that an array of peaks can be 
+ * passed as the output of @ref mightex_apply_multi_estimator.
+ * 
+ * @see mightex_find_peaks
+ */
+typedef struct {
+  double centroid;  ///< intensity-weighted position, in pixels
+  double amplitude; ///< highest value
+  double width;     ///< number of pixels
+  double energy;    ///< sum of the values
+} mightex_peak_t;
+
+/**
+ * @brief Number of values making a @ref mightex_peak_t
+ */
+#define MTX_PEAK_VALUES 4
+
+/**
+ * @brief Options of the multi-peak estimator
+ */
+typedef struct {
+  uint16_t threshold; ///< pixels below are not part of any peak (0: three 
+                      ///< times the dark mean, as the default estimator)
+  uint16_t min_width; ///< narrower peaks are discarded
+} mightex_peak_options_t;
+
+/**
+ * @brief Raw level from which pixels are counted as saturated, by default
+ */
+#define MTX_SATURATION 65000
+
+/**
+ * @brief Frame statistics, filled by @ref mightex_estimator_stats
+ * 
+ * The last three fields are settings, to be given by the caller.
+ */
+typedef struct {
+  uint16_t min;             ///< lowest value
+  uint16_t max;             ///< highest value
+  double mean;              ///< mean value
+  double std;               ///< sample standard deviation
+  uint32_t saturated;       ///< pixels at or above the saturation level
+  uint16_t saturation;      ///< saturation level (0: @ref MTX_SATURATION)
+  uint16_t histogram_bits;  ///< the histogram has 2^bits bins (0: 8 bits)
+  uint32_t *histogram;      ///< optional histogram of the values (can be 
+                            ///< NULL), bin i counting the values v with
+                            ///< `v >> (16 - bits) == i`
+} mightex_stats_t;
+
+/**
+ * @brief A window of contiguous pixels
+ * 
+ * @see mightex_set_roi
+ */
+typedef struct {
+  uint16_t start; ///< first pixel
+  uint16_t width; ///< number of pixels
+} mightex_roi_t;
+
+/**
+ * @brief Maximum number of windows of interest
+ */
+#define MTX_MAX_ROI 8
+
+/**
+ * @brief Settings of the auto-exposure loop
+ * 
+ * @see mightex_set_auto_exposure and mightex_auto_exposure_defaults
+ */
+typedef struct {
+  uint16_t target;            ///< desired peak value above the dark level
+  float tolerance;            ///< accepted deviation, relative to target
+  uint16_t saturation;        ///< pixels at or above this are saturated
+  unsigned int max_saturated; ///< saturated pixels tolerated
+  float min_exptime;          ///< shortest exposure time, in ms (min: 0.1)
+  float max_exptime;          ///< longest exposure time, in ms
+  float max_ratio;            ///< largest change factor of a single step
+  int min_interval_ms;        ///< minimum time between two changes, in ms
+} mightex_auto_exposure_t;
+
+#ifndef SWIG
+
+/**
+ * @brief Opaque structure encapsulating the driver
+ */
+typedef struct mightex mightex_t;
+
+/**
+ * @brief Create a new Mightex object
+ * 
+ * @return mightex_t* 
+ */
+DLLEXPORT
+mightex_t *mightex_new();
+
+/**
+ * @brief Open a camera, with control over the steps taken
+ * 
+ * By default, opening a camera resets it, reads its string descriptors and 
+ * queries its firmware version and device info. For fast reconnections, 
+ * @ref MTX_OPEN_NO_RESET skips the reset and @ref MTX_OPEN_CACHE takes all 
+ * the other details from a cache file, one record per serial number, that is
+ * updated every time a camera is opened with that flag. A camera is taken as 
+ * the cached one when it sits on the same USB port. The cache file is stored 
+ * in the directory set by the `MIGHTEX_CACHE_DIR` environment variable, or in
+ * the user's cache directory (`$XDG_CACHE_HOME` or `~/.cache`, `%LOCALAPPDATA%`
+ * on Windows).
+ * 
+ * The camera is opened on the shared context, as with @ref 
+ * mightex_open_serial. When looking for @p serial, the other cameras are 
+ * queried without being reset.
+ * 
+ * @param serial the serial number, or NULL for the first free camera
+ * @param flags a combination of @ref mtx_open_flags_t values
+ * @param times if not NULL, filled with the time spent in each phase
+ * @return mightex_t* NULL if no camera could be opened
+ */
+DLLEXPORT
+mightex_t *mightex_open(const char *serial, unsigned int flags,
+                        mightex_open_times_t *times);
+
+/**
+ * @brief Open the camera with the given serial number
+ * 
+ * Unlike @ref mightex_new, which opens the first camera found on a private
+ * libusb context, cameras opened with this function and with @ref 
+ * mightex_open_all share a single libusb context. While their acquisition 
+ * threads are running (see @ref mightex_acquisition_start), a single thread 
+ * handles the USB events of all of them.
+ * 
+ * @param serial the serial number, as returned by @ref mightex_serial_no
+ * @return mightex_t* NULL if no free camera has that serial number
+ */
+DLLEXPORT
+mightex_t *mightex_open_serial(const char *serial);
+
+/**
+ * @brief Open all the connected cameras
+ * 
+ * Cameras are opened on the shared libusb context, as with @ref 
+ * mightex_open_serial. Cameras already claimed by someone else are skipped.
+ * Each camera shall be closed with @ref mightex_close.
+ * 
+ * @param list array receiving the opened objects
+ * @param max the size of @p list
+ * @return int the number of opened cameras
+ */
+DLLEXPORT
+int mightex_open_all(mightex_t **list, int max);
+
+/**
+ * @brief Create a new Mightex object backed by a simulated camera
+ * 
+ * The simulated camera speaks the same protocol as the real device and 
+ * produces a synthetic line (a gaussian spot over a constant dark level) at a 
+ * rate set by the exposure time. USB latency and bandwidth are modeled, so 
+ * that the throughput of the different acquisition paths can be compared 
+ * without any hardware attached.
+ * 
+ * @return mightex_t* 
+ */
+DLLEXPORT
+mightex_t *mightex_new_simulated();
+
+/**
+ * @brief Set exposure time, in milliseconds
+ * 
+ * @param m the Mightex object
+ * @param t the exposure time, in ms
+ * @return mtx_result_t 
+ */
+DLLEXPORT
+mtx_result_t mightex_set_exptime(mightex_t *m, float t);
+
+/**
+ * @brief Return the number of available frames
+ * 
+ * The internal buffer of the Mightex 1304 can hold a maximum of 4 frames,
+ * so this function returns a value from 0 to 4. Negative values mean an
+ * error in the underlying usb driver.
+ * 
+ * @param m the Mightex object
+ * @return int 
+ */
+DLLEXPORT
+int mightex_get_buffer_count(mightex_t *m);
+
+/**
+ * @brief Wait until at least one frame is available in the camera buffer
+ * 
+ * Rather than polling the buffer count at a fixed rate, this sleeps until 
+ * shortly before the next frame is expected and only then polls the camera at
+ * short intervals. Frames are expected every exposure time, as set with @ref 
+ * mightex_set_exptime, and the phase is learned from the previous calls. When 
+ * the frame is late, as when waiting for an external trigger, the polling 
+ * interval is progressively increased.
+ * 
+ * @param m the Mightex object
+ * @param timeout_ms maximum wait, in milliseconds
+ * @return int the number of available frames; 0 on timeout, negative on error
+ */
+DLLEXPORT
+int mightex_wait_frame(mightex_t *m, int timeout_ms);
+
+/**
+ * @brief Read a frame from the camera buffer
+ * 
+ * Read a frame and store it internally. Frame data can be accessed with the 
+ * proper accessors. In particular, the pixel values array is stored in the 
+ * location returned by @ref mightex_frame_p. Timestamp and dark mean are also 
+ * updated.
+ * 
+ * @param m the Mightex object
+ * @return mtx_result_t 
+ * @see mightex_frame_p, mightex_frame_timestamp, mightex_dark_mean
+ */
+DLLEXPORT
+mtx_result_t mightex_read_frame(mightex_t *m);
+
+/**
+ * @brief Read a burst of frames from the camera buffer
+ * 
+ * Read up to @ref MTX_MAX_FRAMES frames with a single request, saving the 
+ * per-frame command round-trip of @ref mightex_read_frame. Frames are stored
+ * oldest first and can be accessed by index with @ref mightex_raw_frame_at, 
+ * @ref mightex_frame_timestamp_at and @ref mightex_dark_mean_at. The first 
+ * frame also becomes the current frame, as if read with @ref 
+ * mightex_read_frame.
+ * 
+ * @param m the Mightex object
+ * @param n number of frames to read; if 0, read all the buffered frames as 
+ * reported by @ref mightex_get_buffer_count
+ * @return int the number of frames read (0 if none was available), negative 
+ * on error
+ */
+DLLEXPORT
+int mightex_read_frames(mightex_t *m, int n);
+
+/**
+ * @brief Acquire n frames into caller memory, with a single call
+ * 
+ * Waits for, reads and copies n frames, with their metadata, so that FFI 
+ * consumers (MATLAB, ctypes) pay for one call per batch rather than several
+ * per frame. Raw frames are read in bursts; with @ref MTX_ACQUIRE_FILTERED
+ * they are read one at a time and filtered as by @ref mightex_apply_filter.
+ * With the acquisition thread running, frames are popped from its queue. 
+ * The frames of the last read stay current, as after @ref 
+ * mightex_read_frames.
+ * 
+ * @param m the Mightex object, not streaming
+ * @param dst room for n frames of @ref MTX_PIXELS values, one after the other
+ * @param meta room for n times @ref MTX_META_VALUES values, ordered as in 
+ * @ref mtx_meta_index_t, or NULL
+ * @param n number of frames
+ * @param flags @ref mtx_acquire_flags_t values
+ * @return int the number of frames acquired, less than n if no frame came 
+ * within the timeout or on error
+ */
+DLLEXPORT
+int mightex_acquire_into(mightex_t *m, uint16_t *dst, uint16_t *meta, int n,
+                         unsigned int flags);
+
+/** @name Streaming
+ * 
+ * Continuous acquisition with several frame requests in flight at once, so 
+ * that the bus is never idle between frames. While streaming, do not call 
+ * @ref mightex_read_frame.
+ */
+/**@{*/
+
+/**
+ * @brief Callback invoked for each streamed frame
+ * 
+ * When called, the frame has been stored exactly as @ref mightex_read_frame 
+ * would do, so all the usual accessors, filters and estimators can be used.
+ * 
+ * @param m the Mightex object
+ * @param ud the user data passed to @ref mightex_stream_start
+ */
+typedef void mightex_frame_cb_t(mightex_t *m, void *ud);
+
+/**
+ * @brief Start streaming
+ * 
+ * Allocates a ring of @p depth frame transfers and submits all of them. 
+ * Frames are delivered by @ref mightex_stream_poll.
+ * 
+ * @param m the Mightex object
+ * @param depth number of transfers kept in flight (4 is a good choice)
+ * @param cb callback invoked for each received frame (can be NULL)
+ * @param ud user data passed to the callback (can be NULL)
+ * @return mtx_result_t 
+ */
+DLLEXPORT
+mtx_result_t mightex_stream_start(mightex_t *m, int depth,
+                                  mightex_frame_cb_t *cb, void *ud);
+
+/**
+ * @brief Service the stream
+ * 
+ * Waits up to @p timeout_ms for frames, invokes the callback for each of them
+ * and resubmits the completed transfers.
+ * 
+ * @param m the Mightex object
+ * @param timeout_ms maximum wait, in milliseconds
+ * @return int the number of frames delivered; negative on error or when no 
+ * transfer is in flight anymore
+ */
+DLLEXPORT
+int mightex_stream_poll(mightex_t *m, int timeout_ms);
+
+/**
+ * @brief Stop streaming
+ * 
+ * Cancels the pending transfers and releases the ring.
+ * 
+ * @param m the Mightex object
+ * @return mtx_result_t 
+ */
+DLLEXPORT
+mtx_result_t mightex_stream_stop(mightex_t *m);
+/**@}*/
+
+/** @name Acquisition thread
+ * 
+ * Optional background acquisition: an internal thread streams frames and 
+ * pushes them into a lock-free queue, so that processing hiccups in the 
+ * consumer do not stall the camera. Frames are then taken from the queue with
+ * @ref mightex_pop_frame or @ref mightex_try_pop_frame, which make the popped 
+ * frame the current one, as @ref mightex_read_frame does. Only one consumer
+ * thread shall pop frames. Not available on Windows.
+ */
+/**@{*/
+
+/**
+ * @brief Start the acquisition thread
+ * 
+ * @param m the Mightex object
+ * @param queue_len the queue capacity, in frames (rounded up to a power of 2)
+ * @return mtx_result_t 
+ */
+DLLEXPORT
+mtx_result_t mightex_acquisition_start(mightex_t *m, int queue_len);
+
+/**
+ * @brief Stop the acquisition thread and discard the queued frames
+ * 
+ * @param m the Mightex object
+ * @return mtx_result_t 
+ */
+DLLEXPORT
+mtx_result_t mightex_acquisition_stop(mightex_t *m);
+
+/**
+ * @brief Pop the oldest queued frame, waiting for it if needed
+ * 
+ * @param m the Mightex object
+ * @param timeout_ms maximum wait, in milliseconds
+ * @return mtx_result_t MTX_FAIL on timeout
+ */
+DLLEXPORT
+mtx_result_t mightex_pop_frame(mightex_t *m, int timeout_ms);
+
+/**
+ * @brief Pop the oldest queued frame, if any
+ * 
+ * @param m the Mightex object
+ * @return mtx_result_t MTX_FAIL if the queue is empty
+ */
+DLLEXPORT
+mtx_result_t mightex_try_pop_frame(mightex_t *m);
+
+/**
+ * @brief Number of frames dropped because the queue was full
+ * 
+ * @param m the Mightex object
+ * @return unsigned long 
+ */
+DLLEXPORT
+unsigned long mightex_dropped_frames(mightex_t *m);
+/**@}*/
+
+/** @name Frame rings
+ * 
+ * A frame ring is a file mapped in memory that keeps the last frames read, 
+ * raw, with their metadata, e.g. for post-mortem analysis. A ring set as the
+ * recorder of the camera gets each frame as soon as it is read (with the 
+ * acquisition thread, as soon as it arrives, even if the queue drops it): 
+ * recording is a copy into the mapping, with no system calls, and the oldest
+ * frame is overwritten when the ring is full. Frames are numbered from 0 in 
+ * the order they are recorded. The frames recorded survive a crash of the 
+ * recording process (not a power loss), and any process can open the ring 
+ * for reading at any time, also while recording. 
+ * 
+ * Rings can also live in POSIX shared memory, to publish the frames to other 
+ * processes on the same host: only one process can claim the camera, but any 
+ * number of consumers can map the ring of its publisher and read the frames
+ * with @ref mightex_ring_next, without ever making the publisher wait. Not 
+ * available on Windows.
+ */
+/**@{*/
+
+/**
+ * @brief Frame ring, opened for writing or reading
+ */
+typedef struct mightex_ring mightex_ring_t;
+
+/**
+ * @brief Open a frame ring for writing, creating the file if needed
+ * 
+ * An existing ring holding the same number of frames is continued after its
+ * last frame; any other file is overwritten. The space is allocated at once, 
+ * and only one process at a time can write a ring.
+ * 
+ * @param path the file path
+ * @param frames the ring capacity, in frames (about 7.7 kB each)
+ * @return mightex_ring_t* the ring, or NULL on failure
+ */
+DLLEXPORT
+mightex_ring_t *mightex_ring_create(const char *path, int frames);
+
+/**
+ * @brief Open a frame ring for reading
+ * 
+ * @param path the file path
+ * @return mightex_ring_t* the ring, or NULL on failure
+ */
+DLLEXPORT
+mightex_ring_t *mightex_ring_open(const char *path);
+
+/**
+ * @brief Open a frame ring in shared memory for writing, creating it if 
+ * needed
+ * 
+ * As @ref mightex_ring_create. A ring of a different size is replaced by a 
+ * new one, while the consumers still mapping the old one keep it.
+ * 
+ * @param name the shared memory object name, as `/mightex1304`
+ * @param frames the ring capacity, in frames (about 7.7 kB each)
+ * @return mightex_ring_t* the ring, or NULL on failure
+ */
+DLLEXPORT
+mightex_ring_t *mightex_ring_create_shared(const char *name, int frames);
+
+/**
+ * @brief Open a frame ring in shared memory for reading
+ * 
+ * @param name the shared memory object name
+ * @return mightex_ring_t* the ring, or NULL on failure
+ */
+DLLEXPORT
+mightex_ring_t *mightex_ring_open_shared(const char *name);
+
+/**
+ * @brief Remove the name of a frame ring in shared memory
+ * 
+ * The ring itself goes away when the last process mapping it closes it.
+ * 
+ * @param name the shared memory object name
+ * @return mtx_result_t 
+ */
+DLLEXPORT
+mtx_result_t mightex_ring_remove_shared(const char *name);
+
+/**
+ * @brief Close a frame ring
+ * 
+ * A ring being written shall be detached from the camera first, with 
+ * @ref mightex_set_recorder.
+ * 
+ * @param r the ring (can be NULL)
+ */
+DLLEXPORT
+void mightex_ring_close(mightex_ring_t *r);
+
+/**
+ * @brief Number of frames written to the ring so far
+ * 
+ * The ring holds the frames from `count - capacity` (or 0) to `count - 1`.
+ * 
+ * @param r the ring
+ * @return uint64_t 
+ */
+DLLEXPORT
+uint64_t mightex_ring_count(mightex_ring_t *r);
+
+/**
+ * @brief Capacity of the ring, in frames
+ * 
+ * @param r the ring
+ * @return int 
+ */
+DLLEXPORT
+int mightex_ring_capacity(mightex_ring_t *r);
+
+/**
+ * @brief Copy a frame out of the ring
+ * 
+ * Never waits for the writer: fails if the frame has not been written yet,
+ * has been overwritten, or is overwritten during the copy (in which case the
+ * data copied are meaningless).
+ * 
+ * @param r the ring
+ * @param index the frame number
+ * @param pixels room for @ref MTX_PIXELS raw values, or NULL
+ * @param meta room for @ref MTX_META_VALUES values, ordered as in 
+ * @ref mtx_meta_index_t, or NULL
+ * @return mtx_result_t 
+ */
+DLLEXPORT
+mtx_result_t mightex_ring_read(mightex_ring_t *r, uint64_t index,
+                               uint16_t *pixels, uint16_t *meta);
+
+/**
+ * @brief Copy the next frame out of the ring, waiting for it if needed
+ * 
+ * Reads frame @p *cursor and advances the cursor past it. A consumer that 
+ * falls behind by a whole ring goes on from the newest frame: the frames 
+ * skipped are those between the previous and the new cursor, less one. 
+ * Start from @ref mightex_ring_count to get the frames written from then on.
+ * Waiting is done by polling, so the writer never waits for the readers.
+ * 
+ * @param r the ring
+ * @param cursor the frame number, updated on success
+ * @param pixels room for @ref MTX_PIXELS raw values, or NULL
+ * @param meta room for @ref MTX_META_VALUES values, or NULL
+ * @param timeout_ms maximum wait, in milliseconds
+ * @return mtx_result_t MTX_FAIL on timeout
+ */
+DLLEXPORT
+mtx_result_t mightex_ring_next(mightex_ring_t *r, uint64_t *cursor,
+                               uint16_t *pixels, uint16_t *meta,
+                               int timeout_ms);
+
+/**
+ * @brief Record each frame read into a ring
+ * 
+ * Can only be changed while not streaming.
+ * 
+ * @param m the Mightex object
+ * @param r a ring opened with @ref mightex_ring_create, or NULL to stop 
+ * recording
+ * @return mtx_result_t 
+ */
+DLLEXPORT
+mtx_result_t mightex_set_recorder(mightex_t *m, mightex_ring_t *r);
+
+/**
+ * @brief Publish each frame read into a ring in shared memory
+ * 
+ * The same as @ref mightex_set_recorder, and can be used with it. 
+ * 
+ * @param m the Mightex object
+ * @param r a ring opened with @ref mightex_ring_create_shared, or NULL to 
+ * stop publishing
+ * @return mtx_result_t 
+ */
+DLLEXPORT
+mtx_result_t mightex_set_publisher(mightex_t *m, mightex_ring_t *r);
+/**@}*/
+
+/** @name Frame handles
+ * 
+ * Frames are read in place into reference-counted buffers taken from a pool 
+ * owned by the camera: each read takes a free buffer, so the previous frame is
+ * not overwritten and can be kept without copying, by holding a handle to it.
+ * A held frame never changes, so that it can be handed over to other threads,
+ * and goes back to the pool when its last handle is released, even after 
+ * @ref mightex_close. Holding many frames makes the pool grow, unless it is 
+ * a fixed region set with @ref mightex_set_buffer_pool.
+ */
+/**@{*/
+
+/**
+ * @brief Opaque structure of a frame handle
+ */
+typedef struct mightex_frame mightex_frame_t;
+
+/**
+ * @brief Hold the i-th frame of the last read
+ * 
+ * Each call adds a reference, to be dropped by @ref mightex_frame_release.
+ * 
+ * @param m the Mightex object
+ * @param i frame index, from 0 to @ref mightex_frame_count - 1
+ * @return mightex_frame_t* NULL if @p i is out of range
+ */
+DLLEXPORT
+mightex_frame_t *mightex_frame_hold(mightex_t *m, int i);
+
+/**
+ * @brief Add a reference to a held frame
+ * 
+ * @param f 
+ * @return mightex_frame_t* @p f itself
+ */
+DLLEXPORT
+mightex_frame_t *mightex_frame_retain(mightex_frame_t *f);
+
+/**
+ * @brief Drop a reference to a held frame
+ * 
+ * May be called from any thread.
+ * 
+ * @param f 
+ */
+DLLEXPORT
+void mightex_frame_release(mightex_frame_t *f);
+
+/**
+ * @brief Raw pixel values of a held frame
+ * 
+ * @param f 
+ * @return const uint16_t* An array of @ref MTX_PIXELS elements
+ */
+DLLEXPORT
+const uint16_t *mightex_frame_pixels(mightex_frame_t *f);
+
+/**
+ * @brief Filtered pixel values of a held frame
+ * 
+ * The view filtered by @ref mightex_apply_filter or @ref mightex_process,
+ * which is only allocated when a filter is set. Hold the frame after 
+ * processing it: filtering a held frame changes its view. With regions of
+ * interest, only the pixels in the windows are filtered.
+ * 
+ * @param f 
+ * @return const uint16_t* An array of @ref MTX_PIXELS elements, or NULL if 
+ * the frame was not filtered
+ */
+DLLEXPORT
+const uint16_t *mightex_frame_filtered(mightex_frame_t *f);
+
+/**
+ * @brief Metadata of a held frame
+ * 
+ * @param f 
+ * @param meta 
+ * @return mtx_result_t 
+ */
+DLLEXPORT
+mtx_result_t mightex_frame_info(mightex_frame_t *f, mightex_frame_meta_t *meta);
+
+/**
+ * @brief The mean of the shielded pixels of a held frame
+ * 
+ * @param f 
+ * @return uint16_t 
+ */
+DLLEXPORT
+uint16_t mightex_frame_dark_mean(mightex_frame_t *f);
+
+/**
+ * @brief Size of a region holding a given number of buffers
+ * 
+ * Includes the room for aligning the region start to @ref MTX_BUFFER_ALIGN.
+ * 
+ * @param buffers number of buffers
+ * @param frames frames per buffer
+ * @return size_t bytes
+ * @see mightex_set_buffer_pool
+ */
+DLLEXPORT
+size_t mightex_buffer_pool_size(int buffers, int frames);
+
+/**
+ * @brief Take the frame buffers from a region supplied by the caller
+ * 
+ * The region (e.g. locked in RAM, backed by huge pages or shared with another
+ * process) is split once into fixed buffers, each with room for @p frames raw
+ * frames and a filtered view, aligned to @ref MTX_BUFFER_ALIGN: transfers and
+ * filters then only write there, and nothing is allocated per frame. The pool
+ * does not grow, so the region must hold the current frame, the held frames 
+ * and the frames in flight: one per transfer, plus one to swap in, when 
+ * streaming; one per transfer (@ref MTX_MAX_FRAMES of them) plus the queue 
+ * length with the acquisition thread. Streaming and the acquisition thread do
+ * not start without them; later on, with no free buffer, reads fail and 
+ * streamed frames are dropped. Bursts read at most @p frames frames.
+ * 
+ * The current frame is discarded. The region must stay valid until another
+ * pool is set, or until the camera is closed and all its frames released.
+ * 
+ * @param m the Mightex object, neither streaming nor acquiring
+ * @param mem the region, or NULL to go back to buffers allocated internally
+ * @param size size of the region, in bytes (see @ref 
+ * mightex_buffer_pool_size)
+ * @param frames frames per buffer, from 1 to @ref MTX_MAX_FRAMES
+ * @return mtx_result_t MTX_FAIL if the region cannot hold two buffers, or if
+ * frames of the previous pool are still held
+ */
+DLLEXPORT
+mtx_result_t mightex_set_buffer_pool(mightex_t *m, void *mem, size_t size,
+                                     int frames);
+/**@}*/
+
+/** @name Reconnection
+ * 
+ * When auto-reconnect is enabled, a camera dropping off the bus is looked for
+ * until it shows up again (with the same serial number): it is then reopened,
+ * its exposure time and mode are restored, and streaming resumes into the 
+ * same buffers. A stream transfer failing more than a few times in a row 
+ * (stalled, overflowed or in error) is taken as such a drop. Reconnection is carried out by the functions that talk to the
+ * camera (@ref mightex_read_frame, @ref mightex_wait_frame, @ref 
+ * mightex_stream_poll and the acquisition thread), which meanwhile return no
+ * frames. Each reconnection leaves a gap in the acquired frames, counted by 
+ * @ref mightex_gap_count.
+ */
+/**@{*/
+
+/**
+ * @brief Enable or disable automatic reconnection
+ * 
+ * Where libusb supports it, hotplug notifications are used to detect the 
+ * camera coming back; otherwise it is looked for twice a second.
+ * 
+ * @param m the Mightex object
+ * @param enable 1 to enable, 0 to disable
+ * @return mtx_result_t 
+ */
+DLLEXPORT
+mtx_result_t mightex_set_auto_reconnect(mightex_t *m, int enable);
+
+/**
+ * @brief Number of reconnections since the object was created
+ * 
+ * @param m the Mightex object
+ * @return unsigned long 
+ */
+DLLEXPORT
+unsigned long mightex_gap_count(mightex_t *m);
+
+/**
+ * @brief Make a simulated camera drop off the bus for a while
+ * 
+ * The camera comes back in its power-on state, as a real one would. Meant for
+ * testing the reconnection logic.
+ * 
+ * @param m a Mightex object created with @ref mightex_new_simulated
+ * @param ms how long the camera stays off the bus, in milliseconds
+ * @return mtx_result_t MTX_FAIL if @p m is not simulated
+ */
+DLLEXPORT
+mtx_result_t mightex_simulate_unplug(mightex_t *m, int ms);
+/**@}*/
+
+/** @name Triggered acquisition
+ * 
+ * In @ref MTX_TRIGGER_MODE each frame is started by an external trigger, and
+ * the camera counts the trigger events. Frames can be read with any of the 
+ * acquisition functions: every time a frame becomes the current one, its 
+ * trigger event count is compared with that of the previous frame, and each 
+ * gap is reported as missed triggers, both in the frame metadata and in the 
+ * counter returned by @ref mightex_dropped_triggers. Triggers are missed when
+ * they come faster than the exposure time, and when the camera buffer 
+ * overflows because frames are not read fast enough. Frames taken but dropped
+ * because the queue of the acquisition thread is full are not missed 
+ * triggers: they are counted by @ref mightex_dropped_frames. Tracking starts 
+ * over at each @ref mightex_set_mode.
+ */
+/**@{*/
+
+/**
+ * @brief The metadata of the current frame
+ * 
+ * @param m the Mightex object
+ * @param meta filled with the frame metadata
+ * @return mtx_result_t MTX_FAIL if no frame has been read yet
+ */
+DLLEXPORT
+mtx_result_t mightex_frame_meta(mightex_t *m, mightex_frame_meta_t *meta);
+
+/**
+ * @brief The metadata of the i-th frame of the last burst
+ * 
+ * @param m the Mightex object
+ * @param i frame index, from 0 to @ref mightex_frame_count - 1
+ * @param meta filled with the frame metadata
+ * @return mtx_result_t MTX_FAIL if @p i is out of range
+ * @see mightex_read_frames
+ */
+DLLEXPORT
+mtx_result_t mightex_frame_meta_at(mightex_t *m, int i,
+                                   mightex_frame_meta_t *meta);
+
+/**
+ * @brief Number of triggers missed since the object was created
+ * 
+ * @param m the Mightex object
+ * @return unsigned long 
+ */
+DLLEXPORT
+unsigned long mightex_dropped_triggers(mightex_t *m);
+
+/**
+ * @brief Attach a trigger source to a simulated camera
+ * 
+ * @param m a Mightex object created with @ref mightex_new_simulated
+ * @param hz the trigger rate, or 0 for no triggers
+ * @return mtx_result_t MTX_FAIL if @p m is not simulated
+ */
+DLLEXPORT
+mtx_result_t mightex_simulate_trigger(mightex_t *m, float hz);
+/**@}*/
+
+/** @name Auto-exposure
+ * 
+ * An optional control loop adjusting the exposure time so that the frame peak,
+ * less the dark mean, stays close to a target value. Each frame read with any
+ * of the acquisition functions is checked, as long as it was exposed with the
+ * current exposure time: when saturated, the exposure time is cut by the 
+ * largest allowed step, otherwise it is scaled by the ratio between target 
+ * and actual level. Changes are sent to the camera at most once per frame and
+ * no more often than @ref mightex_auto_exposure_t::min_interval_ms. With the
+ * acquisition thread running, frames are checked and changes sent on that 
+ * thread, as frames arrive. The current value is returned by 
+ * @ref mightex_exptime.
+ */
+/**@{*/
+
+/**
+ * @brief Fill the auto-exposure settings with default values
+ * 
+ * Target 40000, 10% tolerance, no pixel above 65000, exposure time from 0.1 
+ * ms to the camera maximum, changing by up to 4 times per step, no rate 
+ * limit.
+ * 
+ * @param ae the settings to be filled
+ */
+DLLEXPORT
+void mightex_auto_exposure_defaults(mightex_auto_exposure_t *ae);
+
+/**
+ * @brief Enable or disable the auto-exposure loop
+ * 
+ * @param m the Mightex object
+ * @param ae the settings (copied), or NULL to disable
+ * @return mtx_result_t MTX_FAIL if the settings are not valid
+ */
+DLLEXPORT
+mtx_result_t mightex_set_auto_exposure(mightex_t *m,
+                                       const mightex_auto_exposure_t *ae);
+/**@}*/
+
+/** @name Calibration
+ * 
+ * Per-pixel correction of the dark signal and of the photo-response 
+ * non-uniformity (PRNU). For each exposure time, a dark table is captured 
+ * with the sensor covered, then a gain table under a uniform illumination;
+ * tables for up to 16 exposure times are kept. Setting @ref 
+ * mightex_filter_calibrated as filter, each frame is corrected as 
+ * `(raw - dark) * gain`, with the tables captured at the exposure time of the
+ * frame; frames without tables get the default dark subtraction. The tables 
+ * can be saved to a file, to be loaded at startup instead of calibrating 
+ * again.
+ */
+/**@{*/
+
+/**
+ * @brief Capture the dark table for the current exposure time
+ * 
+ * Averages @p n frames, which shall be taken with no light on the sensor. 
+ * Any previous gain table for the same exposure time is reset. Frames are 
+ * read one at a time, so streaming and the acquisition thread shall not be 
+ * running.
+ * 
+ * @param m the Mightex object
+ * @param n number of frames to be averaged (1 to 65536)
+ * @return mtx_result_t 
+ */
+DLLEXPORT
+mtx_result_t mightex_calibrate_dark(mightex_t *m, int n);
+
+/**
+ * @brief Capture the gain table for the current exposure time
+ * 
+ * Averages @p n frames, which shall be taken under a uniform illumination, 
+ * well below saturation. The gain of each pixel brings its response, less 
+ * the dark table, to the average one; pixels with almost no response are 
+ * left alone. A dark table for the same exposure time shall exist.
+ * 
+ * @param m the Mightex object
+ * @param n number of frames to be averaged (1 to 65536)
+ * @return mtx_result_t 
+ */
+DLLEXPORT
+mtx_result_t mightex_calibrate_flat(mightex_t *m, int n);
+
+/**
+ * @brief Save all the calibration tables to a binary file
+ * 
+ * @param m the Mightex object
+ * @param path the file path
+ * @return mtx_result_t 
  */
-typedef enum { MTX_NORMAL_MODE = 0, MTX_TRIGGER_MODE = 1 } mtx_mode_t;
+DLLEXPORT
+mtx_result_t mightex_calibration_save(mightex_t *m, const char *path);
 
 /**
- * @brief Standard exit values for library functions
+ * @brief Load the calibration tables from a file
+ * 
+ * Replaces all the current tables. Fails if the file was saved from a camera
+ * with a different serial number.
+ * 
+ * @param m the Mightex object
+ * @param path the file path
+ * @return mtx_result_t 
  */
-typedef enum { MTX_FAIL = 0, MTX_OK = 1 } mtx_result_t;
+DLLEXPORT
+mtx_result_t mightex_calibration_load(mightex_t *m, const char *path);
 
-#ifndef SWIG
+/**
+ * @brief Discard all the calibration tables
+ * 
+ * @param m the Mightex object
+ */
+DLLEXPORT
+void mightex_calibration_clear(mightex_t *m);
 
 /**
- * @brief Opaque structure encapsulating the driver
+ * @brief Number of exposure times with calibration tables
+ * 
+ * @param m the Mightex object
+ * @return int 
  */
-typedef struct mightex mightex_t;
+DLLEXPORT
+int mightex_calibration_count(mightex_t *m);
 
 /**
- * @brief Create a new Mightex object
+ * @brief Make a simulated camera look at a different scene
  * 
- * @return mightex_t* 
+ * @param m a Mightex object created with @ref mightex_new_simulated
+ * @param scene the scene
+ * @return mtx_result_t MTX_FAIL if @p m is not simulated
  */
 DLLEXPORT
-mightex_t *mightex_new();
+mtx_result_t mightex_simulate_scene(mightex_t *m, mtx_sim_scene_t scene);
+/**@}*/
+
+/** @name Frame accumulator
+ * 
+ * Co-adding of raw frames, for low-light measurements: per-pixel sums of N 
+ * frames and of their squares, giving mean and variance. All the memory is 
+ * allocated by @ref mightex_accumulator_new, nothing while adding frames.
+ */
+/**@{*/
 
 /**
- * @brief Set exposure time, in milliseconds
+ * @brief Opaque structure of a frame accumulator
+ */
+typedef struct mightex_accumulator mightex_accumulator_t;
+
+/**
+ * @brief Create a new frame accumulator
  * 
- * @param m the Mightex object
- * @param t the exposure time, in ms
- * @return mtx_result_t 
+ * In sliding mode, the accumulator keeps a copy of the last @p frames frames,
+ * so as to take the oldest out of the sums.
+ * 
+ * @param frames the number of frames N (at least 1)
+ * @param mode block or sliding window
+ * @return mightex_accumulator_t* NULL on failure
  */
 DLLEXPORT
-mtx_result_t mightex_set_exptime(mightex_t *m, float t);
+mightex_accumulator_t *mightex_accumulator_new(uint16_t frames,
+                                              mtx_acc_mode_t mode);
 
 /**
- * @brief Return the number of available frames
+ * @brief Free a frame accumulator
  * 
- * The internal buffer of the Mightex 1304 can hold a maximum of 4 frames,
- * so this function returns a value from 0 to 4. Negative values mean an
- * error in the underlying usb driver.
+ * @param acc 
+ */
+DLLEXPORT
+void mightex_accumulator_free(mightex_accumulator_t *acc);
+
+/**
+ * @brief Discard all the frames summed so far
  * 
- * @param m the Mightex object
+ * @param acc 
+ */
+DLLEXPORT
+void mightex_accumulator_reset(mightex_accumulator_t *acc);
+
+/**
+ * @brief Add a frame of @ref MTX_PIXELS values
+ * 
+ * @param acc 
+ * @param data the frame, e.g. @ref mightex_raw_frame_p
+ * @return int the number of frames in the sums
+ */
+DLLEXPORT
+int mightex_accumulator_add(mightex_accumulator_t *acc, const uint16_t *data);
+
+/**
+ * @brief Add the current raw frame of a camera
+ * 
+ * @param acc 
+ * @param m 
+ * @return int the number of frames in the sums
+ */
+DLLEXPORT
+int mightex_accumulator_add_frame(mightex_accumulator_t *acc, mightex_t *m);
+
+/**
+ * @brief Number of frames in the sums
+ * 
+ * It grows up to N; in block mode, the block is complete when it equals N.
+ * 
+ * @param acc 
  * @return int 
  */
 DLLEXPORT
-int mightex_get_buffer_count(mightex_t *m);
+int mightex_accumulator_count(mightex_accumulator_t *acc);
 
 /**
- * @brief Read a frame from the camera buffer
+ * @brief Running per-pixel sums
  * 
- * Read a frame and store it internally. Frame data can be accessed with the 
- * proper accessors. In particular, the pixel values array is stored in the 
- * location returned by @ref mightex_frame_p. Timestamp and dark mean are also 
- * updated.
+ * @param acc 
+ * @return const uint32_t* an array of @ref MTX_PIXELS sums
+ */
+DLLEXPORT
+const uint32_t *mightex_accumulator_sum(mightex_accumulator_t *acc);
+
+/**
+ * @brief Per-pixel mean of the frames in the sums
  * 
- * @param m the Mightex object
- * @return mtx_result_t 
- * @see mightex_frame_p, mightex_frame_timestamp, mightex_dark_mean
+ * @param acc 
+ * @param mean an array of @ref MTX_PIXELS values
  */
 DLLEXPORT
-mtx_result_t mightex_read_frame(mightex_t *m);
+void mightex_accumulator_mean(mightex_accumulator_t *acc, double *mean);
 
+/**
+ * @brief Per-pixel sample variance of the frames in the sums
+ * 
+ * Zero with less than two frames.
+ * 
+ * @param acc 
+ * @param var an array of @ref MTX_PIXELS values
+ */
+DLLEXPORT
+void mightex_accumulator_variance(mightex_accumulator_t *acc, double *var);
+/**@}*/
 
 /**
  * @brief Close the object
@@ -161,6 +1243,12 @@ BYTE mightex_gpio_read(mightex_t *m, BYTE reg);
  * 
  * An *estimator* is a function that operates on all pixel values and returns
  * a single estimate (a mean value, peak, etc.). 
+ * 
+ * When windows of interest are set (see @ref mightex_set_roi), filters and 
+ * estimators are only applied to them: @p data points to the first pixel of 
+ * a window within @ref mightex_frame_p, so that positions are frame indices 
+ * once offset by `data - mightex_frame_p(m)`, as done by the default 
+ * estimators.
  */
  /**@{*/ 
 
@@ -193,6 +1281,51 @@ typedef void mightex_filter_t(mightex_t *m, uint16_t * const raw_data, uint16_t
  */
 typedef double mightex_estimator_t(mightex_t *m, uint16_t * const data, uint16_t len, void *ud);
 
+/**
+ * @brief Filter applying the per-pixel calibration tables
+ * 
+ * To be passed to @ref mightex_set_filter. 
+ * 
+ * @see mightex_calibrate_dark and mightex_calibrate_flat
+ */
+DLLEXPORT
+void mightex_filter_calibrated(mightex_t *m, uint16_t *const data,
+                               uint16_t len, void *ud);
+
+/**
+ * @brief Estimator computing the statistics of the frame
+ * 
+ * To be passed to @ref mightex_set_estimator, with a pointer to @ref 
+ * mightex_stats_t as user data, or to be called directly on any array. 
+ * Computed in a single, vectorized pass with integer sums, so that mean and 
+ * standard deviation are exact up to the final rounding. Frames are limited
+ * to 65535 pixels.
+ * 
+ * @return double the standard deviation
+ */
+DLLEXPORT
+double mightex_estimator_stats(mightex_t *m, uint16_t *const data,
+                               uint16_t len, void *ud);
+
+/**
+ * @brief Multi-value estimator prototype
+ * 
+ * An estimator returning more than one value. The default one finds all the 
+ * peaks in the frame (see @ref mightex_find_peaks).
+ * 
+ * @param m 
+ * @param data an array of data (the filtered values from @ref 
+ * mightex_frame_p)
+ * @param len the array length
+ * @param ud optional user data (can be NULL)
+ * @param out the array receiving the values
+ * @param max the size of @p out
+ * @return int the number of values written to @p out
+ */
+typedef int mightex_multi_estimator_t(mightex_t *m, uint16_t *const data,
+                                      uint16_t len, void *ud, double *out,
+                                      int max);
+
 /**
  * @brief Set the filter function
  * 
@@ -260,6 +1393,180 @@ void mightex_reset_estimator(mightex_t *m);
 DLLEXPORT
 double mightex_apply_estimator(mightex_t *m, void *userdata);
 
+/**
+ * @brief Set the multi-value estimator function
+ * 
+ * @param m 
+ * @param estimator 
+ * @note the estimator function works on the **filtered** frame data
+ */
+DLLEXPORT
+void mightex_set_multi_estimator(mightex_t *m,
+                                 mightex_multi_estimator_t *estimator);
+
+/**
+ * @brief Reset the multi-value estimator to the default one
+ * 
+ * By default, the multi-value estimator finds all the peaks in the frame.
+ * 
+ * @param m 
+ */
+DLLEXPORT
+void mightex_reset_multi_estimator(mightex_t *m);
+
+/**
+ * @brief Apply the multi-value estimator function
+ * 
+ * @param m 
+ * @param userdata for the default estimator, a pointer to @ref 
+ * mightex_peak_options_t (or NULL for the default options)
+ * @param out the array receiving the values
+ * @param max the size of @p out
+ * @return int the number of values written to @p out
+ */
+DLLEXPORT
+int mightex_apply_multi_estimator(mightex_t *m, void *userdata, double *out,
+                                  int max);
+
+/**
+ * @brief Find all the peaks in the filtered frame
+ * 
+ * Peaks are the runs of contiguous pixels not below a threshold, found in a 
+ * single pass over the frame, left to right. This is the default 
+ * multi-value estimator, called directly.
+ * 
+ * @param m 
+ * @param opt the options (or NULL for the default ones)
+ * @param peaks the array receiving the peaks
+ * @param max the size of @p peaks
+ * @return int the number of peaks found (at most @p max)
+ */
+DLLEXPORT
+int mightex_find_peaks(mightex_t *m, const mightex_peak_options_t *opt,
+                       mightex_peak_t *peaks, int max);
+
+/**
+ * @brief Filter the current frame and apply the estimator, in one go
+ * 
+ * Equivalent to @ref mightex_apply_filter followed by @ref 
+ * mightex_apply_estimator, always starting from the raw frame. With the 
+ * default filter and estimator, the copy of the raw data, the dark 
+ * subtraction and the centroid are computed in a single pass. Once this 
+ * function has been called, frames are no longer copied to @ref 
+ * mightex_frame_p when read, as this function does it: the area is only 
+ * updated by this function, @ref mightex_apply_filter and @ref 
+ * mightex_apply_estimator.
+ * 
+ * @param m 
+ * @param userdata passed to the filter and to the estimator
+ * @return double the estimator result
+ */
+DLLEXPORT
+double mightex_process(mightex_t *m, void *userdata);
+
+/**@}*/
+
+/** @name Regions of interest
+ * 
+ * Restrict filters and estimators to a few windows of the frame, where the 
+ * signal is, rather than processing all the pixels.
+ * 
+ * The filter is applied to each window (once to overlapping ones) and the 
+ * multi-value estimator to each of them, in pixel order. The estimator is 
+ * applied to window 0, which can also track its result: it is then recentred 
+ * on each valid estimate and, when the estimate is lost (NaN or off the 
+ * sensor), the next frame is searched in full before narrowing down again.
+ * 
+ * Pixels of @ref mightex_frame_p outside the windows hold the current raw
+ * frame, unfiltered: only the windows go through the filter.
+ */
+/**@{*/
+
+/**
+ * @brief Set the windows of interest
+ * 
+ * @param m 
+ * @param roi an array of windows, window 0 being the one used by the 
+ * estimator
+ * @param n the number of windows (up to @ref MTX_MAX_ROI), 0 to go back to the
+ * full frame (and to stop tracking)
+ * @return mtx_result_t MTX_FAIL if a window is empty or off the sensor
+ */
+DLLEXPORT
+mtx_result_t mightex_set_roi(mightex_t *m, const mightex_roi_t *roi, int n);
+
+/**
+ * @brief Get the windows of interest
+ * 
+ * While tracking, window 0 is where the next frame will be processed.
+ * 
+ * @param m 
+ * @param roi an array receiving the windows (can be NULL)
+ * @param max the size of @p roi
+ * @return int the number of windows, 0 for the full frame
+ */
+DLLEXPORT
+int mightex_roi(mightex_t *m, mightex_roi_t *roi, int max);
+
+/**
+ * @brief Make window 0 follow the estimate
+ * 
+ * The width of the window is kept. Tracking starts from where the window is, 
+ * falling back to a full-frame search if the estimate is not found there.
+ * 
+ * @param m 
+ * @param enable 
+ * @return mtx_result_t MTX_FAIL if no window is set
+ */
+DLLEXPORT
+mtx_result_t mightex_set_roi_tracking(mightex_t *m, int enable);
+
+/**
+ * @brief Whether the next frame is searched in full, the estimate being lost
+ * 
+ * @param m 
+ * @return int 
+ */
+DLLEXPORT
+int mightex_roi_searching(mightex_t *m);
+
+/**
+ * @brief Number of times the tracked estimate was lost
+ * 
+ * @param m 
+ * @return unsigned long 
+ */
+DLLEXPORT
+unsigned long mightex_roi_searches(mightex_t *m);
+
+/**
+ * @brief Get the spans of pixels the filter works on
+ * 
+ * The windows sorted by start and merged where they overlap or touch, or the
+ * full frame without windows or while searching. For code filtering the 
+ * frame on its own, as @ref Pipeline does.
+ * 
+ * @param m 
+ * @param spans an array of @ref MTX_MAX_ROI spans, receiving them
+ * @return int the number of spans
+ */
+DLLEXPORT
+int mightex_roi_spans(mightex_t *m, mightex_roi_t *spans);
+
+/**
+ * @brief Feed an estimate computed over window 0 to the tracking
+ * 
+ * What @ref mightex_process does with the estimator result, for code 
+ * estimating on its own, as @ref Pipeline does. Nothing happens unless 
+ * tracking is enabled.
+ * 
+ * @param m 
+ * @param x the estimate, as a frame index
+ * @return double @p x
+ */
+DLLEXPORT
+double mightex_roi_track(mightex_t *m, double x);
+
 /**@}*/
 
 /** @name Accessors
@@ -291,6 +1598,15 @@ char *mightex_serial_no(mightex_t *m);
 DLLEXPORT
 char *mightex_version(mightex_t *m);
 
+/**
+ * @brief The exposure time last set with @ref mightex_set_exptime
+ * 
+ * @param m 
+ * @return float exposure time in ms (0 if never set)
+ */
+DLLEXPORT
+float mightex_exptime(mightex_t *m);
+
 /**
  * @brief The Mightex library software version and details
  * 
@@ -304,23 +1620,55 @@ DLLEXPORT
 char *mightex_sw_version();
 
 /**
- * @brief Return the pointer to the raw image storage area
+ * @brief The instruction set used by the pixel processing functions
  * 
- * The last frame, as collected with @ref mightex_read_frame, is stored as an
- * array of `uint16_t` in the location pointed by the returned pointer.
+ * Filters and estimators are vectorized where the CPU allows it: this tells 
+ * which of the available implementations was picked for the running CPU.
  * 
- * @param m 
- * @return uint16_t* An array of @ref MTX_PIXELS elements
+ * @return const char* one of "avx2", "sse2", "neon" or "scalar"
  */
 DLLEXPORT
-uint16_t *mightex_frame_p(mightex_t *m);
+const char *mightex_simd();
 
 /**
  * @brief Return the pointer to the filtered image storage area
  * 
  * The last frame, as collected with @ref mightex_read_frame, is copied as an
  * array of `uint16_t` in the location pointed by the returned pointer. This
- * array of data is filtered upon calling @ref mightex_apply_filter.
+ * array of data is filtered upon calling @ref mightex_apply_filter. The copy
+ * is only made when needed, and not at all without a filter: the pointer is 
+ * then @ref mightex_raw_frame_p itself, unless a pipeline wrote its output
+ * with @ref mightex_frame_output. It changes with every read.
+ * 
+ * @param m 
+ * @return uint16_t* An array of @ref MTX_PIXELS elements
+ */
+DLLEXPORT
+uint16_t *mightex_frame_p(mightex_t *m);
+
+/**
+ * @brief Return the filtered image storage area, to be written over the spans
+ * 
+ * For code filtering the raw frame into its own output, as @ref Pipeline 
+ * does: the area is allocated if needed, never the raw frame itself, and it 
+ * is what @ref mightex_frame_p returns from now on, until the next read, even
+ * without a filter. The pixels outside @ref mightex_roi_spans are copied from
+ * the raw frame, those within are left to the caller.
+ * 
+ * @param m 
+ * @return uint16_t* An array of @ref MTX_PIXELS elements, or NULL if it 
+ * could not be allocated
+ */
+DLLEXPORT
+uint16_t *mightex_frame_output(mightex_t *m);
+
+/**
+ * @brief Return the pointer to the raw image storage area
+ * 
+ * The last frame, as collected with @ref mightex_read_frame, is stored as an
+ * array of `uint16_t` in the location pointed by the returned pointer, which 
+ * changes with every read. To keep a frame, hold it with @ref 
+ * mightex_frame_hold.
  * 
  * @param m 
  * @return uint16_t* An array of @ref MTX_PIXELS elements
@@ -351,6 +1699,50 @@ uint16_t mightex_frame_timestamp(mightex_t *m);
 DLLEXPORT
 uint16_t mightex_dark_mean(mightex_t *m);
 
+/**
+ * @brief Number of frames read by the last read operation
+ * 
+ * @param m 
+ * @return int 
+ * @see mightex_read_frames
+ */
+DLLEXPORT
+int mightex_frame_count(mightex_t *m);
+
+/**
+ * @brief Return the raw pixel values of the i-th frame of the last burst
+ * 
+ * @param m 
+ * @param i frame index, from 0 to @ref mightex_frame_count - 1
+ * @return uint16_t* An array of @ref MTX_PIXELS elements, or NULL if @p i is
+ * out of range
+ * @see mightex_read_frames
+ */
+DLLEXPORT
+uint16_t *mightex_raw_frame_at(mightex_t *m, int i);
+
+/**
+ * @brief The timestamp of the i-th frame of the last burst
+ * 
+ * @param m 
+ * @param i frame index, from 0 to @ref mightex_frame_count - 1
+ * @return uint16_t 
+ * @see mightex_read_frames
+ */
+DLLEXPORT
+uint16_t mightex_frame_timestamp_at(mightex_t *m, int i);
+
+/**
+ * @brief The mean of the shielded pixels of the i-th frame of the last burst
+ * 
+ * @param m 
+ * @param i frame index, from 0 to @ref mightex_frame_count - 1
+ * @return uint16_t 
+ * @see mightex_read_frames
+ */
+DLLEXPORT
+uint16_t mightex_dark_mean_at(mightex_t *m, int i);
+
 /**
  * @brief Return the number of pixels (@ref MTX_PIXELS)
  * 